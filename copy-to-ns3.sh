@@ -9,5 +9,6 @@ mkdir $NS3_FOLDER/rapidjson
 cp  -r $RAPIDJSON_FOLDER/include/rapidjson/* $NS3_FOLDER/rapidjson/
 cp  src/applications/model/* $NS3_FOLDER/src/applications/model/
 cp  src/applications/helper/* $NS3_FOLDER/src/applications/helper/
+cp  src/applications/test/* $NS3_FOLDER/src/applications/test/
 cp  src/internet/helper/* $NS3_FOLDER/src/internet/helper/
 cp  scratch/* $NS3_FOLDER/scratch/
@@ -15,8 +15,11 @@
  */
 
 #include <fstream>
+#include <sstream>
+#include <math.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <stddef.h>
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -89,6 +92,8 @@ main (int argc, char *argv[])
   int reconciliationMode = 0;
   int invIntervalSeconds = 1;
   int reconciliationIntervalSeconds = 30;
+  int reconciliationThreshold = 400;
+  int reconciliationMaxDelaySeconds = 60;
   int blackHoles = 0;
 
   int lowfanoutOrderOut = 0;
@@ -101,6 +106,25 @@ main (int argc, char *argv[])
   int bisectionRate = 0;
 
   bool bhDetection = false;
+  bool bhInference = false;
+  bool sketchReconciliation = false;
+
+  int wireFormat = 0;
+  int invBatchSize = 0;
+  int coalesceWindowMs = 0;
+  double dandelionFluff = 0.1;
+  double dandelionEmbargo = 30;
+  double filterOverlap = 0.5;
+  double blockInterval = 0;
+  int miners = 16;
+  bool messageChannel = false;
+  int logLevel = 0;
+  std::string txRates = "9,2.66,7,2.033,14,14,3.6,2.45,2.067,9,2.067";
+  int txRatePeriod = 60;
+  double txEmitterSkew = 0;
+  std::string scheduler = "map";
+  uint32_t seed = 1;
+  uint64_t run = 1;
 
   int publicSpies = 0;
   int privateSpies = 0;
@@ -115,10 +139,12 @@ main (int argc, char *argv[])
   cmd.AddValue ("publicSpies", "public spy nodes", publicSpies);
   cmd.AddValue ("privateSpies", "private spy nodes", privateSpies);
 
-  cmd.AddValue ("protocol", "Used protocol: 0 — Default, 1 — Filters on links", protocol);
+  cmd.AddValue ("protocol", "Used protocol: 0 — Default, 1 — Filters on links, 2 — Outgoing filters, 5 — Dandelion++", protocol);
   cmd.AddValue ("reconciliationMode", "reconciliation mode: 0 — Off, 1 — Time-based, 2 — Set size based", reconciliationMode);
   cmd.AddValue ("invIntervalSeconds", "invIntervalSeconds", invIntervalSeconds);
   cmd.AddValue ("reconciliationIntervalSeconds", "reconciliationIntervalSeconds", reconciliationIntervalSeconds);
+  cmd.AddValue ("reconciliationThreshold", "set size which starts a reconciliation with a peer in set size based mode", reconciliationThreshold);
+  cmd.AddValue ("reconciliationMaxDelay", "longest time in seconds between two reconciliations with a peer in set size based mode", reconciliationMaxDelaySeconds);
   cmd.AddValue ("blackHoles", "black hole nodes", blackHoles);
 
   cmd.AddValue ("lowfanoutOrderOut", "lowfanout order to out connections in units", lowfanoutOrderOut);
@@ -129,9 +155,39 @@ main (int argc, char *argv[])
   cmd.AddValue ("qEstimationMultiplier", "formula for estimations is in bitcoin-node.cc", qEstimationMultiplier);
   cmd.AddValue ("bisectionRate", "how many bisection sets of syndromes to send (0, 1, 3, 7, ...2^n-1)", bisectionRate);
   cmd.AddValue ("bhDetection", "black holes trivial detection", bhDetection);
-
+  cmd.AddValue ("bhInference", "find the black holes by their behaviour instead of their MODE messages", bhInference);
+  cmd.AddValue ("sketchReconciliation", "reconcile with sketches, bisection and fallback instead of sending the full sets", sketchReconciliation);
+  cmd.AddValue ("wireFormat", "message encoding: 0 — JSON, 1 — binary, 2 — binary headers with virtual payloads", wireFormat);
+  cmd.AddValue ("invBatchSize", "max inventories per INV on a per-peer trickle timer, 0 — one INV per transaction", invBatchSize);
+  cmd.AddValue ("blockInterval", "mean seconds between two blocks relayed as compact blocks, 0 — no blocks", blockInterval);
+  cmd.AddValue ("miners", "public nodes which mine the blocks", miners);
+  cmd.AddValue ("coalesceWindowMs", "frames sent to a peer within this window share a single packet, 0 — no coalescing", coalesceWindowMs);
+  cmd.AddValue ("dandelionFluff", "probability that a stem relay fluffs the transaction, with protocol 5", dandelionFluff);
+  cmd.AddValue ("dandelionEmbargo", "mean of the embargo timers of stem transactions in seconds, with protocol 5", dandelionEmbargo);
+  cmd.AddValue ("filterOverlap", "extra share of the hash space each filtered link covers, with protocols 1 and 2", filterOverlap);
+  cmd.AddValue ("logLevel", "log level of the bitcoin nodes: 0 — none, 1 — warn, 2 — info, 3 — debug, 4 — function", logLevel);
+  cmd.AddValue ("messageChannel", "deliver messages through a latency/bandwidth channel instead of TCP over point-to-point links", messageChannel);
+
+  cmd.AddValue ("txRates", "comma separated transactions per second of the whole network in each period; the last one holds until the end", txRates);
+  cmd.AddValue ("txRatePeriod", "length of each period of txRates in seconds", txRatePeriod);
+  cmd.AddValue ("txEmitterSkew", "0 — emitters are chosen uniformly, s > 0 — the i-th emitter is chosen with a weight of 1/i^s", txEmitterSkew);
+  cmd.AddValue ("scheduler", "event scheduler: map (the ns-3 default), heap, calendar, list or wheel", scheduler);
+  cmd.AddValue ("seed", "seed of the random numbers; the same seed and run give the same simulation", seed);
+  cmd.AddValue ("run", "run number, for independent replications with the same seed", run);
   cmd.Parse(argc, argv);
 
+  RngSeedManager::SetSeed (seed);
+  RngSeedManager::SetRun (run);
+
+  std::map<std::string, std::string> schedulerTypes = {{"map", "ns3::MapScheduler"}, {"heap", "ns3::HeapScheduler"},
+    {"calendar", "ns3::CalendarScheduler"}, {"list", "ns3::ListScheduler"}, {"wheel", "ns3::WheelScheduler"}};
+  if (schedulerTypes.find(scheduler) == schedulerTypes.end())
+    NS_FATAL_ERROR ("Unknown scheduler " << scheduler);
+  GlobalValue::Bind ("SchedulerType", StringValue (schedulerTypes[scheduler]));
+
+  if (reconciliationThreshold < 0)
+    NS_FATAL_ERROR ("reconciliationThreshold must not be negative, got " << reconciliationThreshold);
+
   // TODO Configure
   uint averageBlockGenInterval = 10 * 60;
   uint targetNumberOfBlocks = 5000;
@@ -162,10 +218,21 @@ main (int argc, char *argv[])
   #endif
 
 
-  LogComponentEnable("BitcoinNode", LOG_LEVEL_INFO);
+  const LogLevel logLevels[] = {LOG_NONE, LOG_LEVEL_WARN, LOG_LEVEL_INFO, LOG_LEVEL_DEBUG, LOG_LEVEL_FUNCTION};
+  if (logLevel > 0)
+  {
+    LogLevel level = logLevels[std::min (logLevel, 4)];
+    LogComponentEnable("BitcoinNode", level);
+    LogComponentEnable("BitcoinChannel", level);
+  }
+
+  if (messageChannel && systemCount > 1)
+    NS_FATAL_ERROR ("The message channel can not deliver messages across MPI ranks, run it with a single process");
+  if (wireFormat == VIRTUAL_WIRE && systemCount > 1)
+    NS_FATAL_ERROR ("Virtual payloads leave the messages in the memory of the sender, run them with a single process");
 
   BitcoinTopologyHelper bitcoinTopologyHelper (systemCount, totalNoNodes, publicIPNodes, minConnectionsPerNode,
-                                               maxConnectionsPerNode, systemId);
+                                               maxConnectionsPerNode, systemId, messageChannel);
   // Install stack on Grid
   InternetStackHelper stack;
   bitcoinTopologyHelper.InstallStack (stack);
@@ -188,9 +255,19 @@ main (int argc, char *argv[])
   protocolSettings.lowfanoutOrderOut = lowfanoutOrderOut;
   protocolSettings.loopAccommodation = loopAccommodation;
   protocolSettings.reconciliationMode = reconciliationMode;
-  protocolSettings.bhDetection = bhDetection;
+  protocolSettings.bhDetection = bhDetection || bhInference;
+  protocolSettings.bhInference = bhInference;
   protocolSettings.reconciliationIntervalSeconds = reconciliationIntervalSeconds;
+  protocolSettings.reconciliationThreshold = reconciliationThreshold;
+  protocolSettings.reconciliationMaxDelaySeconds = reconciliationMaxDelaySeconds;
   protocolSettings.qEstimationMultiplier = qEstimationMultiplier;
+  protocolSettings.sketchReconciliation = sketchReconciliation;
+  protocolSettings.wireFormat = WireFormat(wireFormat);
+  protocolSettings.invBatchSize = invBatchSize;
+  protocolSettings.coalesceWindowMs = coalesceWindowMs;
+  protocolSettings.dandelionFluffProbability = dandelionFluff;
+  protocolSettings.dandelionEmbargoSeconds = dandelionEmbargo;
+  protocolSettings.filterOverlap = filterOverlap;
 
 
 
@@ -198,12 +275,51 @@ main (int argc, char *argv[])
   BitcoinNodeHelper bitcoinNodeHelper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), bitcoinPort),
                                         nodesConnections[0], peersDownloadSpeeds[0],  peersUploadSpeeds[0], nodesInternetSpeeds[0], stats,
                                       protocolSettings);
+  bitcoinNodeHelper.SetChannel (bitcoinTopologyHelper.GetChannel ());
   ApplicationContainer bitcoinNodes;
 
 
   std::map<int, int> nodeSystemIds;
 
   assert(TX_EMITTERS + blackHoles <= totalNoNodes);
+
+  // Every rank sets up all the emitters, to replay the same arrivals and number the transactions the same way
+  std::vector<uint32_t> txEmitters;
+  std::vector<double> txEmitterWeights;
+  for(auto &node : nodesConnections)
+  {
+    if (node.first > publicIPNodes + 100 && node.first < TX_EMITTERS + publicIPNodes + 100)
+      txEmitters.push_back(node.first);
+  }
+  for (uint32_t i = 0; txEmitterSkew > 0 && i < txEmitters.size(); i++)
+    txEmitterWeights.push_back(1 / pow(i + 1, txEmitterSkew));
+
+  std::vector<double> txRateCurve;
+  std::stringstream txRatesStream(txRates);
+  std::string txRate;
+  while (std::getline(txRatesStream, txRate, ','))
+    txRateCurve.push_back(std::stod(txRate));
+
+  Ptr<BitcoinTxGenerator> txGenerator = CreateObject<BitcoinTxGenerator> ();
+  txGenerator->SetEmitters(txEmitters, txEmitterWeights);
+  txGenerator->SetRates(txRateCurve, Seconds(txRatePeriod));
+  bitcoinNodeHelper.SetTxGenerator(txGenerator);
+
+  // The miners are the last public nodes, away from the black holes and the spies
+  Ptr<BitcoinBlockGenerator> blockGenerator;
+  if (blockInterval > 0)
+  {
+    assert(miners > 0 && miners <= publicIPNodes - blackHoles - publicSpies);
+    std::vector<uint32_t> minerIds;
+    for (int i = 0; i < miners; i++)
+      minerIds.push_back(publicIPNodes - 1 - i);
+
+    blockGenerator = CreateObject<BitcoinBlockGenerator> ();
+    blockGenerator->SetMiners(minerIds);
+    blockGenerator->SetInterval(Seconds(blockInterval));
+    bitcoinNodeHelper.SetBlockGenerator(blockGenerator);
+  }
+
   for(auto &node : nodesConnections)
   {
     Ptr<Node> targetNode = bitcoinTopologyHelper.GetNode (node.first);
@@ -242,6 +358,10 @@ main (int argc, char *argv[])
 
   bitcoinNodes.Start (Seconds (start));
   bitcoinNodes.Stop (Minutes (stop));
+  // The emitters start creating transactions once the nodes have announced their modes
+  txGenerator->Start (Seconds (start + 5), Seconds (simulTime - TIME_NOT_TO_COUNT));
+  if (blockGenerator)
+    blockGenerator->Start (Seconds (start + 5), Seconds (simulTime - TIME_NOT_TO_COUNT));
 
   tStartSimulation = get_wall_time();
 
@@ -260,11 +380,21 @@ main (int argc, char *argv[])
 
   #ifdef MPI_TEST
 
-    int            blocklen[14] = {1, 1, 1, 1, 1, 1,
-                                   1, 1, 1, 1, 1, 1, 1, 1};
-    MPI_Aint       disp[14];
-    MPI_Datatype   dtypes[14] = {MPI_INT, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_INT,
-                                 MPI_DOUBLE, MPI_LONG, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT};
+    int            blocklen[38] = {1, 1, 1, 1, 1, 1,
+                                   1, 1, 1, 1, 1, 1, 1, 1,
+                                   1, 1, 1, 1,
+                                   MESSAGE_TYPES, MESSAGE_TYPES, MESSAGE_TYPES,
+                                   1, 1, 1, 1, 1, 1, 1,
+                                   1, 1, 1, 1,
+                                   1, 1, 1, 1, 1, 1};
+    MPI_Aint       disp[38];
+    MPI_Datatype   dtypes[38] = {MPI_INT, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_INT,
+                                 MPI_DOUBLE, MPI_LONG, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT,
+                                 MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG,
+                                 MPI_LONG, MPI_LONG, MPI_LONG,
+                                 MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG,
+                                 MPI_INT, MPI_INT, MPI_INT, MPI_DOUBLE,
+                                 MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_DOUBLE, MPI_DOUBLE};
     MPI_Datatype   mpi_nodeStatisticsType;
 
     disp[0] = offsetof(nodeStatistics, nodeId);
@@ -281,9 +411,33 @@ main (int argc, char *argv[])
     disp[11] = offsetof(nodeStatistics, ignoredFilters);
     disp[12] = offsetof(nodeStatistics, reconcils);
     disp[13] = offsetof(nodeStatistics, mode);
-
-
-    MPI_Type_create_struct (14, blocklen, disp, dtypes, &mpi_nodeStatisticsType);
+    disp[14] = offsetof(nodeStatistics, rxReadCalls);
+    disp[15] = offsetof(nodeStatistics, rxBytesReceived);
+    disp[16] = offsetof(nodeStatistics, rxBytesBuffered);
+    disp[17] = offsetof(nodeStatistics, rxFramesDecoded);
+    disp[18] = offsetof(nodeStatistics, txPackets);
+    disp[19] = offsetof(nodeStatistics, txBytes);
+    disp[20] = offsetof(nodeStatistics, txSegments);
+    disp[21] = offsetof(nodeStatistics, knownTxBytes);
+    disp[22] = offsetof(nodeStatistics, peersKnowTxBytes);
+    disp[23] = offsetof(nodeStatistics, invEventsExecuted);
+    disp[24] = offsetof(nodeStatistics, invEventsCancelled);
+    disp[25] = offsetof(nodeStatistics, dandelionStemRelays);
+    disp[26] = offsetof(nodeStatistics, dandelionEmbargoFluffs);
+    disp[27] = offsetof(nodeStatistics, filteredInvs);
+    disp[28] = offsetof(nodeStatistics, bhLinks);
+    disp[29] = offsetof(nodeStatistics, bhDetected);
+    disp[30] = offsetof(nodeStatistics, bhFalsePositives);
+    disp[31] = offsetof(nodeStatistics, bhDetectionLatency);
+    disp[32] = offsetof(nodeStatistics, blocksMined);
+    disp[33] = offsetof(nodeStatistics, blocksReceived);
+    disp[34] = offsetof(nodeStatistics, blockRoundTrips);
+    disp[35] = offsetof(nodeStatistics, blockTxsMissing);
+    disp[36] = offsetof(nodeStatistics, blockLatencySum);
+    disp[37] = offsetof(nodeStatistics, blockLatencyMax);
+
+
+    MPI_Type_create_struct (38, blocklen, disp, dtypes, &mpi_nodeStatisticsType);
     MPI_Type_commit (&mpi_nodeStatisticsType);
 
     if (systemId != 0 && systemCount > 1)
@@ -322,6 +476,30 @@ main (int argc, char *argv[])
         stats[recv.nodeId].ignoredFilters = recv.ignoredFilters;
         stats[recv.nodeId].reconcils = recv.reconcils;
         stats[recv.nodeId].mode = recv.mode;
+        stats[recv.nodeId].rxReadCalls = recv.rxReadCalls;
+        stats[recv.nodeId].rxBytesReceived = recv.rxBytesReceived;
+        stats[recv.nodeId].rxBytesBuffered = recv.rxBytesBuffered;
+        stats[recv.nodeId].rxFramesDecoded = recv.rxFramesDecoded;
+        std::copy (recv.txPackets, recv.txPackets + MESSAGE_TYPES, stats[recv.nodeId].txPackets);
+        std::copy (recv.txBytes, recv.txBytes + MESSAGE_TYPES, stats[recv.nodeId].txBytes);
+        std::copy (recv.txSegments, recv.txSegments + MESSAGE_TYPES, stats[recv.nodeId].txSegments);
+        stats[recv.nodeId].knownTxBytes = recv.knownTxBytes;
+        stats[recv.nodeId].peersKnowTxBytes = recv.peersKnowTxBytes;
+        stats[recv.nodeId].invEventsExecuted = recv.invEventsExecuted;
+        stats[recv.nodeId].invEventsCancelled = recv.invEventsCancelled;
+        stats[recv.nodeId].dandelionStemRelays = recv.dandelionStemRelays;
+        stats[recv.nodeId].dandelionEmbargoFluffs = recv.dandelionEmbargoFluffs;
+        stats[recv.nodeId].filteredInvs = recv.filteredInvs;
+        stats[recv.nodeId].bhLinks = recv.bhLinks;
+        stats[recv.nodeId].bhDetected = recv.bhDetected;
+        stats[recv.nodeId].bhFalsePositives = recv.bhFalsePositives;
+        stats[recv.nodeId].bhDetectionLatency = recv.bhDetectionLatency;
+        stats[recv.nodeId].blocksMined = recv.blocksMined;
+        stats[recv.nodeId].blocksReceived = recv.blocksReceived;
+        stats[recv.nodeId].blockRoundTrips = recv.blockRoundTrips;
+        stats[recv.nodeId].blockTxsMissing = recv.blockTxsMissing;
+        stats[recv.nodeId].blockLatencySum = recv.blockLatencySum;
+        stats[recv.nodeId].blockLatencyMax = recv.blockLatencyMax;
   	    count++;
       }
     }
@@ -337,13 +515,20 @@ main (int argc, char *argv[])
 
     PrintStatsForEachNode(stats, totalNoNodes, publicIPNodes, blackHoles, bisectionRate);
 
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+
 
     std::cout << "\nThe simulation ran for " << tFinish - tStart << "s simulating "
               << stop << "mins. Performed " << stop * secsPerMin / (tFinish - tStart)
               << " faster than realtime.\n" << "Setup time = " << tStartSimulation - tStart << "s\n"
               <<"It consisted of " << totalNoNodes << " nodes ( with minConnectionsPerNode = "
               << minConnectionsPerNode << " and maxConnectionsPerNode = " << maxConnectionsPerNode
-              << "\n" << "Protocol Type: " << protocol << "\n";
+              << "\n" << "Protocol Type: " << protocol << "\n"
+              << "Transport: " << (messageChannel ? "message channel" : "TCP") << "\n"
+              << "Scheduler: " << scheduler << "\n"
+              << "Transactions created: " << txGenerator->GetArrivals () << "\n"
+              << "Peak memory (rank 0) = " << usage.ru_maxrss / 1024.0 << "MB\n";
 
   }
 
@@ -423,6 +608,9 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes, int publicIPN
   long fallbackCost = 0;
   std::vector<long> sizeWhenReconFailed;
 
+  long measuredReconciliations = 0;
+  double measuredReconLatency = 0;
+
   long setSizesPublic = 0;
   int countSetSizesPublic = 0;
   long setSizesPrivate = 0;
@@ -435,6 +623,41 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes, int publicIPN
 
   long totalOnTheFlyCollisions = 0;
 
+  long rxReadCalls = 0;
+  long rxBytesReceived = 0;
+  long rxBytesBuffered = 0;
+  long rxFramesDecoded = 0;
+
+  long txPackets[MESSAGE_TYPES]{0};
+  long txBytes[MESSAGE_TYPES]{0};
+  long txSegments[MESSAGE_TYPES]{0};
+
+  long knownTxBytes = 0;
+  long peersKnowTxBytes = 0;
+  long knownTxs = 0;
+
+  long invEventsExecuted = 0;
+  long invEventsCancelled = 0;
+
+  long dandelionStemRelays = 0;
+  long dandelionEmbargoFluffs = 0;
+
+  long filteredInvs = 0;
+
+  long bhLinks = 0;
+  long bhDetected = 0;
+  long bhFalsePositives = 0;
+  long peerLinks = 0;
+  double bhDetectionLatency = 0;
+
+  long blocksMined = 0;
+  long blocksReceived = 0;
+  long blockRoundTrips = 0;
+  long blockTxsMissing = 0;
+  double blockLatencySum = 0;
+  double blockLatencyMax = 0;
+  int knownTxNodes = 0;
+
   std::vector<int> ratiosA(100, 0);
 
   for (int it = 0; it < totalNodes; it++ )
@@ -473,7 +696,13 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes, int publicIPN
         reconcilDiffsDistr[el.estimatedDiff]++;
       else
         reconcilDiffsDistr[DIFFS_DISTR_SIZE - 1]++;
-      if (el.estimatedDiff < el.diffSize) {
+      // Sketch reconciliations measure their outcome, the others are estimated with bisectionRate
+      bool measured = (el.outcome != 0);
+      if (measured) {
+        measuredReconciliations++;
+        measuredReconLatency += el.latency;
+      }
+      if (measured ? el.outcome > 1 : el.estimatedDiff < el.diffSize) {
         if (stats[it].nodeId < publicIPNodes) {
           reconFailedPublic++;
         } else {
@@ -481,10 +710,18 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes, int publicIPN
         }
         sizeWhenReconFailed.push_back(el.diffSize);
         totalReconciliationsFailed++;
-        bisectionSyndromes += bisectionRate * el.estimatedDiff;
-        if (el.estimatedDiff * (bisectionRate + 1) < el.diffSize) {
-          failAfterBisection++;
-          fallbackCost += (el.setInSize + el.setOutSize);
+        if (measured) {
+          bisectionSyndromes += el.syndromes - el.estimatedDiff;
+          if (el.outcome == 3) {
+            failAfterBisection++;
+            fallbackCost += el.fallbackSize;
+          }
+        } else {
+          bisectionSyndromes += bisectionRate * el.estimatedDiff;
+          if (el.estimatedDiff * (bisectionRate + 1) < el.diffSize) {
+            failAfterBisection++;
+            fallbackCost += (el.setInSize + el.setOutSize);
+          }
         }
       } else {
         totalSyndromesSent += el.estimatedDiff;
@@ -514,6 +751,44 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes, int publicIPN
 
     totalOnTheFlyCollisions += stats[it].onTheFlyCollisions;
 
+    rxReadCalls += stats[it].rxReadCalls;
+    rxBytesReceived += stats[it].rxBytesReceived;
+    rxBytesBuffered += stats[it].rxBytesBuffered;
+    rxFramesDecoded += stats[it].rxFramesDecoded;
+
+    knownTxBytes += stats[it].knownTxBytes;
+    peersKnowTxBytes += stats[it].peersKnowTxBytes;
+    knownTxs += stats[it].txReceived;
+    knownTxNodes++;
+
+    invEventsExecuted += stats[it].invEventsExecuted;
+    invEventsCancelled += stats[it].invEventsCancelled;
+
+    dandelionStemRelays += stats[it].dandelionStemRelays;
+    dandelionEmbargoFluffs += stats[it].dandelionEmbargoFluffs;
+
+    filteredInvs += stats[it].filteredInvs;
+    ignoredFilters += stats[it].ignoredFilters;
+
+    bhLinks += stats[it].bhLinks;
+    bhDetected += stats[it].bhDetected;
+    bhFalsePositives += stats[it].bhFalsePositives;
+    peerLinks += stats[it].connections;
+    bhDetectionLatency += stats[it].bhDetectionLatency;
+    blocksMined += stats[it].blocksMined;
+    blocksReceived += stats[it].blocksReceived;
+    blockRoundTrips += stats[it].blockRoundTrips;
+    blockTxsMissing += stats[it].blockTxsMissing;
+    blockLatencySum += stats[it].blockLatencySum;
+    blockLatencyMax = std::max(blockLatencyMax, stats[it].blockLatencyMax);
+
+    for (int type = 0; type < MESSAGE_TYPES; type++)
+    {
+      txPackets[type] += stats[it].txPackets[type];
+      txBytes[type] += stats[it].txBytes[type];
+      txSegments[type] += stats[it].txSegments[type];
+    }
+
     for (int txCount = 0; txCount < stats[it].txReceived; txCount++)
     {
       txRecvTime txTime = stats[it].txReceivedTimes[txCount];
@@ -565,9 +840,61 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes, int publicIPN
   std::cout << "Reconciliations failed public: " << reconFailedPublic << std::endl;
   std::cout << "Reconciliations failed private: " << reconFailedPrivate << std::endl;
   std::cout << "Reconciliations failed after 1 bisection: " << failAfterBisection << std::endl;
+  if (measuredReconciliations != 0)
+    std::cout << "Average sketch reconciliation latency: " << measuredReconLatency / measuredReconciliations << "s" << std::endl;
 
   std::cout << "Total messages: " << totalMessages << std::endl;
 
+  if (rxReadCalls != 0) {
+    std::cout << "Frames decoded per read: " << rxFramesDecoded * 1.0 / rxReadCalls << std::endl;
+    std::cout << "Bytes received per read: " << rxBytesReceived * 1.0 / rxReadCalls << std::endl;
+    std::cout << "Bytes left buffered per read: " << rxBytesBuffered * 1.0 / rxReadCalls << std::endl;
+  }
+
+  for (int type = 0; type < MESSAGE_TYPES; type++)
+  {
+    if (txPackets[type] == 0 && txBytes[type] == 0)
+      continue;
+    std::cout << "Sent messages of type " << type << ": " << txPackets[type] << " packets, "
+              << txBytes[type] << " bytes, " << txSegments[type] << " segments" << std::endl;
+  }
+
+  if (knownTxNodes != 0 && knownTxs != 0) {
+    std::cout << "Known transactions index: " << knownTxBytes / knownTxNodes << " Bytes per node, "
+              << knownTxBytes * 1.0 / knownTxs << " Bytes per transaction" << std::endl;
+    std::cout << "Peers which know each transaction: " << peersKnowTxBytes / knownTxNodes << " Bytes per node, "
+              << peersKnowTxBytes * 1.0 / knownTxs << " Bytes per transaction" << std::endl;
+  }
+
+  if (invEventsExecuted + invEventsCancelled != 0)
+    std::cout << "Announcements to peers: " << invEventsExecuted << " sent, " << invEventsCancelled << " cancelled ("
+              << invEventsCancelled * 100.0 / (invEventsExecuted + invEventsCancelled) << "%)" << std::endl;
+
+  if (dandelionStemRelays != 0)
+    std::cout << "Dandelion stem relays: " << dandelionStemRelays << ", fluffed by an expired embargo: "
+              << dandelionEmbargoFluffs << std::endl;
+
+  if (filteredInvs != 0)
+    std::cout << "Announcements left out by relay filters: " << filteredInvs << ", INVs received outside the requested filters: "
+              << ignoredFilters << std::endl;
+
+  if (bhLinks + bhFalsePositives != 0)
+    std::cout << "Black hole links detected: " << bhDetected << " of " << bhLinks << " ("
+              << (bhLinks ? bhDetected * 100.0 / bhLinks : 0) << "%), after "
+              << (bhDetected ? bhDetectionLatency / bhDetected : 0) << "s on average, false positives: "
+              << bhFalsePositives << " of " << peerLinks - bhLinks << " links ("
+              << (peerLinks > bhLinks ? bhFalsePositives * 100.0 / (peerLinks - bhLinks) : 0) << "%)" << std::endl;
+
+  // Black holes drop the blocks, and a miner does not receive its own block
+  if (blocksMined != 0)
+    std::cout << "Blocks mined: " << blocksMined << ", reached "
+              << blocksReceived * 100.0 / (blocksMined * (totalNodes - blackHoles - 1)) << "% of the nodes after "
+              << (blocksReceived ? blockLatencySum / blocksReceived : 0) << "s on average and " << blockLatencyMax
+              << "s at most, reconstructed without a round trip: "
+              << (blocksReceived ? (blocksReceived - blockRoundTrips) * 100.0 / blocksReceived : 0)
+              << "%, missing transactions per round trip: "
+              << (blockRoundTrips ? blockTxsMissing * 1.0 / blockRoundTrips : 0) << std::endl;
+
   if (countSetSizesPublic != 0)
     std::cout << "Average set sizes public: " << setSizesPublic / countSetSizesPublic << std::endl;
   if (countSetSizesPrivate != 0)
@@ -622,6 +949,8 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes, int publicIPN
   {
     std::vector<double> relayTimes = txTimes->second;
     std::sort(relayTimes.begin(), relayTimes.end());
+    // Every rank registered every transaction, so the creation time is known here
+    double created = BitcoinTxRegistry::Get().GetCreationTime(txTimes->first);
     int i = 0;
     while (i < GRANULARITY)
     {
@@ -629,7 +958,7 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes, int publicIPN
       if (relayTimes.size() <= activeNodes * currentFraction) {
         break;
       }
-      percentRelayTimes[i].push_back(relayTimes.at(int(relayTimes.size() * currentFraction)) - relayTimes.front());
+      percentRelayTimes[i].push_back(relayTimes.at(int(relayTimes.size() * currentFraction)) - created);
       i++;
     }
   }
@@ -737,9 +1066,9 @@ void CollectReconcilData(nodeStatistics *stats, int totalNoNodes,
 {
   // return;
   #ifdef MPI_TEST
-    int            blocklen[5] = {1, 1, 1, 1, 1};
-    MPI_Aint       disp[5];
-    MPI_Datatype   dtypes[5] = {MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT};
+    int            blocklen[9] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
+    MPI_Aint       disp[9];
+    MPI_Datatype   dtypes[9] = {MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_DOUBLE};
     MPI_Datatype   mpi_reconcilItem;
 
     disp[0] = offsetof(reconcilItem, nodeId);
@@ -747,8 +1076,12 @@ void CollectReconcilData(nodeStatistics *stats, int totalNoNodes,
     disp[2] = offsetof(reconcilItem, setOutSize);
     disp[3] = offsetof(reconcilItem, diffSize);
     disp[4] = offsetof(reconcilItem, estimatedDiff);
+    disp[5] = offsetof(reconcilItem, outcome);
+    disp[6] = offsetof(reconcilItem, syndromes);
+    disp[7] = offsetof(reconcilItem, fallbackSize);
+    disp[8] = offsetof(reconcilItem, latency);
 
-    MPI_Type_create_struct (5, blocklen, disp, dtypes, &mpi_reconcilItem);
+    MPI_Type_create_struct (9, blocklen, disp, dtypes, &mpi_reconcilItem);
     MPI_Type_commit (&mpi_reconcilItem);
 
     if (systemId != 0 && systemCount > 1)
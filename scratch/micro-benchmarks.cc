@@ -0,0 +1,265 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Micro-benchmarks of the data structures on the hot paths of the bitcoin nodes.
+ *
+ * ./waf --run "micro-benchmarks --benchmark=knownTxs --txs=2310 --emitters=1000 --announcements=8"
+ * ./waf --run "micro-benchmarks --benchmark=schedulers --pending=200000 --operations=5000000 --poissonShare=0.8"
+ * ./waf --run "micro-benchmarks --benchmark=reconDiff --overlap=0.9 --reconciliations=2000"
+ */
+
+#include <chrono>
+#include <random>
+#include <unordered_set>
+#include <set>
+#include <algorithm>
+#include <math.h>
+#include "ns3/core-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BitcoinMicroBenchmarks");
+
+static double
+ElapsedNs (std::chrono::steady_clock::time_point start, long operations)
+{
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now () - start;
+  return elapsed.count () / std::max (operations, 1L);
+}
+
+/**
+ * Replays the transactions a node learns during a run: every transaction is looked up once per
+ * announcing peer and inserted on its first announcement, as HandleMessage and SaveTxData do.
+ */
+static void
+BenchmarkKnownTxs (int txs, int emitters, int announcements)
+{
+  std::mt19937 generator (1);
+  std::uniform_int_distribution<uint32_t> origin (0, emitters - 1);
+  std::vector<uint32_t> emitterIds;
+  std::vector<int> stream;
+
+  for (int i = 0; i < emitters; i++)
+    emitterIds.push_back (i);
+  BitcoinTxRegistry::Get ().SetEmitters (emitterIds);
+
+  for (int i = 0; i < txs; i++)
+  {
+    int txId = BitcoinTxRegistry::Get ().Register (origin (generator), i, 0);
+    for (int j = 0; j < announcements; j++)
+      stream.push_back (txId);
+  }
+  // Announcements of different transactions interleave
+  for (size_t i = 0; i + 2 * announcements <= stream.size (); i += announcements)
+    std::shuffle (stream.begin () + i, stream.begin () + i + 2 * announcements, generator);
+
+  long operations = stream.size ();
+  long found;
+
+  {
+    auto start = std::chrono::steady_clock::now ();
+    std::vector<int> known;
+    found = 0;
+    for (int txId: stream)
+    {
+      if (std::find (known.begin (), known.end (), txId) != known.end ())
+        found++;
+      else
+        known.push_back (txId);
+    }
+    std::cout << "std::vector + std::find: " << ElapsedNs (start, operations) << " ns per announcement, "
+              << known.capacity () * sizeof (int) * 1.0 / known.size () << " Bytes per transaction, "
+              << found << " duplicates" << std::endl;
+  }
+
+  {
+    auto start = std::chrono::steady_clock::now ();
+    std::unordered_set<int> known;
+    found = 0;
+    for (int txId: stream)
+    {
+      if (!known.insert (txId).second)
+        found++;
+    }
+    // One node of an int and a next pointer per element, plus the bucket array
+    double bytes = known.size () * (sizeof (void*) + sizeof (int) + sizeof (size_t)) + known.bucket_count () * sizeof (void*);
+    std::cout << "std::unordered_set: " << ElapsedNs (start, operations) << " ns per announcement, ~"
+              << bytes / known.size () << " Bytes per transaction, " << found << " duplicates" << std::endl;
+  }
+
+  {
+    auto start = std::chrono::steady_clock::now ();
+    KnownTxSet known;
+    found = 0;
+    for (int txId: stream)
+    {
+      if (known.Contains (txId))
+        found++;
+      else
+        known.Insert (txId);
+    }
+    std::cout << "KnownTxSet: " << ElapsedNs (start, operations) << " ns per announcement, "
+              << known.GetMemoryUsage () * 1.0 / known.Size () << " Bytes per transaction, "
+              << found << " duplicates" << std::endl;
+  }
+}
+
+/**
+ * Runs the hold model on each scheduler: the next event is removed and a new one is inserted,
+ * with a pending event count close to the 10k node scenario. A share of the delays comes from
+ * PoissonNextSend, whole seconds plus 0.1 s, and the others are link latencies in nanoseconds.
+ */
+static void
+BenchmarkSchedulers (int pending, long operations, double poissonShare)
+{
+  const char *schedulers[] = {"ns3::MapScheduler", "ns3::HeapScheduler", "ns3::CalendarScheduler", "ns3::WheelScheduler"};
+
+  for (const char *name: schedulers)
+  {
+    ObjectFactory factory;
+    factory.SetTypeId (name);
+    Ptr<Scheduler> scheduler = factory.Create<Scheduler> ();
+    std::mt19937_64 generator (1);
+    std::uniform_real_distribution<double> uniform (0, 1);
+    uint32_t uid = 0;
+    uint64_t now = 0;
+
+    auto delay = [&] () -> uint64_t {
+      if (uniform (generator) < poissonShare)
+        return uint64_t (int (-log (1 - uniform (generator)) * 2 + 0.5) * 1000000000ULL + 100000000ULL);
+      return 10000000 + uint64_t (uniform (generator) * 290000000);
+    };
+    auto insert = [&] () {
+      Scheduler::Event ev;
+      ev.impl = 0;
+      ev.key.m_ts = now + delay ();
+      ev.key.m_uid = uid++;
+      ev.key.m_context = 0;
+      scheduler->Insert (ev);
+    };
+
+    for (int i = 0; i < pending; i++)
+      insert ();
+
+    auto start = std::chrono::steady_clock::now ();
+    for (long i = 0; i < operations; i++)
+    {
+      now = scheduler->RemoveNext ().key.m_ts;
+      insert ();
+    }
+    double ns = ElapsedNs (start, operations);
+    std::cout << name << ": " << ns << " ns per event, " << 1e9 / ns << " events per second" << std::endl;
+
+    while (!scheduler->IsEmpty ())
+      scheduler->RemoveNext ();
+  }
+}
+
+/**
+ * Compares two reconciliation sets of each size up to RECON_MAX_SET_SIZE, sharing a part of their
+ * transactions, with the former lookups of each transaction in the other set and with the merge
+ * of ReconciliationSets::Difference, sorting included.
+ */
+static void
+BenchmarkReconDiff (double overlap, long reconciliations)
+{
+  std::mt19937 generator (1);
+
+  for (int size = 25; size <= RECON_MAX_SET_SIZE; size *= 2)
+  {
+    // Recent transactions, so the indices of both sets are close to each other
+    std::vector<int> pool (2 * size);
+    for (int i = 0; i < 2 * size; i++)
+      pool[i] = 1000000 + i * 3;
+    std::shuffle (pool.begin (), pool.end (), generator);
+    int shared = size * overlap;
+    std::vector<int> mine (pool.begin (), pool.begin () + size);
+    std::vector<int> his (pool.begin (), pool.begin () + shared);
+    his.insert (his.end (), pool.begin () + size, pool.begin () + 2 * size - shared);
+    std::shuffle (his.begin (), his.end (), generator);
+
+    long misses = 0;
+    auto start = std::chrono::steady_clock::now ();
+    for (long r = 0; r < reconciliations; r++)
+    {
+      std::set<int> nodeBtransactions;
+      for (int txId: his)
+      {
+        nodeBtransactions.insert (txId);
+        if (std::find (mine.begin (), mine.end (), txId) == mine.end ())
+          misses++;
+      }
+      for (int txId: mine)
+        if (std::find (nodeBtransactions.begin (), nodeBtransactions.end (), txId) == nodeBtransactions.end ())
+          misses++;
+    }
+    double lookups = ElapsedNs (start, reconciliations);
+
+    start = std::chrono::steady_clock::now ();
+    for (long r = 0; r < reconciliations; r++)
+    {
+      std::vector<int> mySet (mine), hisSet (his), iMiss, heMisses;
+      std::sort (mySet.begin (), mySet.end ());
+      std::sort (hisSet.begin (), hisSet.end ());
+      ReconciliationSets::Difference (mySet, hisSet, iMiss, heMisses);
+      misses -= iMiss.size () + heMisses.size ();
+    }
+    double merge = ElapsedNs (start, reconciliations);
+
+    NS_ASSERT_MSG (misses == 0, "The two differences disagree");
+    std::cout << "Sets of " << size << " transactions: " << lookups / 1000 << " us with lookups, "
+              << merge / 1000 << " us with the merge" << std::endl;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string benchmark = "knownTxs";
+  int txs = 2310;
+  int emitters = TX_EMITTERS;
+  int announcements = 8;
+  int pending = 200000;
+  long operations = 5000000;
+  double poissonShare = 0.8;
+  double overlap = 0.9;
+  long reconciliations = 2000;
+
+  CommandLine cmd;
+  cmd.AddValue ("benchmark", "the benchmark to run: knownTxs, schedulers, reconDiff", benchmark);
+  cmd.AddValue ("txs", "the transactions a node learns", txs);
+  cmd.AddValue ("emitters", "the nodes which create transactions", emitters);
+  cmd.AddValue ("announcements", "the announcements of each transaction a node receives", announcements);
+  cmd.AddValue ("pending", "the events pending in the schedulers", pending);
+  cmd.AddValue ("operations", "the events each scheduler runs", operations);
+  cmd.AddValue ("poissonShare", "the share of the events delayed by PoissonNextSend", poissonShare);
+  cmd.AddValue ("overlap", "the share of the transactions both reconciliation sets hold", overlap);
+  cmd.AddValue ("reconciliations", "the reconciliations of each set size", reconciliations);
+  cmd.Parse (argc, argv);
+
+  if (benchmark == "knownTxs")
+    BenchmarkKnownTxs (txs, emitters, announcements);
+  else if (benchmark == "schedulers")
+    BenchmarkSchedulers (pending, operations, poissonShare);
+  else if (benchmark == "reconDiff")
+    BenchmarkReconDiff (overlap, reconciliations);
+  else
+    NS_FATAL_ERROR ("Unknown benchmark " << benchmark);
+
+  return 0;
+}
@@ -84,6 +84,9 @@ BitcoinNodeHelper::InstallPriv (Ptr<Node> node)
   app->SetNodeInternetSpeeds(m_internetSpeeds);
   app->SetNodeStats(m_nodeStats);
   app->SetProperties(m_timeToRun, m_mode, m_systemId, m_outPeers, m_protocolSettings);
+  app->SetChannel(m_channel);
+  app->SetTxGenerator(m_txGenerator);
+  app->SetBlockGenerator(m_blockGenerator);
 
   node->AddApplication (app);
 
@@ -131,5 +134,23 @@ BitcoinNodeHelper::SetProperties (uint64_t timeToRun, enum ModeType mode, int sy
   m_outPeers = outPeers;
 }
 
+void
+BitcoinNodeHelper::SetChannel (Ptr<BitcoinChannel> channel)
+{
+  m_channel = channel;
+}
+
+void
+BitcoinNodeHelper::SetTxGenerator (Ptr<BitcoinTxGenerator> txGenerator)
+{
+  m_txGenerator = txGenerator;
+}
+
+void
+BitcoinNodeHelper::SetBlockGenerator (Ptr<BitcoinBlockGenerator> blockGenerator)
+{
+  m_blockGenerator = blockGenerator;
+}
+
 
 } // namespace ns3
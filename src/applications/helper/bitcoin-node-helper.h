@@ -11,6 +11,9 @@
 #include "ns3/application-container.h"
 #include "ns3/uinteger.h"
 #include "ns3/bitcoin.h"
+#include "ns3/bitcoin-channel.h"
+#include "ns3/bitcoin-tx-generator.h"
+#include "ns3/bitcoin-block-generator.h"
 
 namespace ns3 {
 
@@ -108,6 +111,24 @@ public:
   void SetProperties (uint64_t timeToRun, enum ModeType mode, int systemId,
     std::vector<Ipv4Address> outPeers);
 
+  /**
+   * \brief Makes the installed nodes exchange their messages through a BitcoinChannel instead of TCP sockets
+   * \param channel the channel, or 0 to use sockets
+   */
+  void SetChannel (Ptr<BitcoinChannel> channel);
+
+  /**
+   * \brief Makes the installed emitters create the transactions a BitcoinTxGenerator hands them
+   * \param txGenerator the generator
+   */
+  void SetTxGenerator (Ptr<BitcoinTxGenerator> txGenerator);
+
+  /**
+   * \brief Makes the installed miners build and relay the blocks a BitcoinBlockGenerator hands them
+   * \param blockGenerator the generator
+   */
+  void SetBlockGenerator (Ptr<BitcoinBlockGenerator> blockGenerator);
+
 protected:
   /**
    * Install an ns3::PacketSink on the node configured with all the
@@ -133,6 +154,9 @@ protected:
   enum ModeType									              m_mode;
 
   ProtocolSettings m_protocolSettings;
+  Ptr<BitcoinChannel> m_channel;
+  Ptr<BitcoinTxGenerator> m_txGenerator;
+  Ptr<BitcoinBlockGenerator> m_blockGenerator;
 };
 
 } // namespace ns3
@@ -17,6 +17,7 @@
  */
 
 #include "ns3/bitcoin-topology-helper.h"
+#include "ns3/bitcoin-rng.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/point-to-point-helper.h"
 #include "ns3/constant-position-mobility-model.h"
@@ -38,7 +39,7 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("BitcoinTopologyHelper");
 
 BitcoinTopologyHelper::BitcoinTopologyHelper (uint32_t noCpus, uint32_t totalNoNodes, uint32_t publicIPNodes, int minConnectionsPerNode, int maxConnectionsPerNode,
-						                                       uint32_t systemId)
+						                                       uint32_t systemId, bool messageChannel)
   : m_noCpus(noCpus), m_totalNoNodes (totalNoNodes),
     m_minConnectionsPerNode (minConnectionsPerNode), m_maxConnectionsPerNode (maxConnectionsPerNode),
 	m_totalNoLinks (0), m_publicIPNodes(publicIPNodes),
@@ -48,7 +49,9 @@ BitcoinTopologyHelper::BitcoinTopologyHelper (uint32_t noCpus, uint32_t totalNoN
   std::vector<uint32_t>     nodes;    //nodes contain the ids of the nodes
   double                    tStart = GetWallTime();
   double                    tFinish;
-  srand (1000);
+  BitcoinRng                rng;
+
+  rng.SetStream (BitcoinRng::TOPOLOGY_STREAM);
 
 
   if (m_systemId == 0)
@@ -75,7 +78,7 @@ BitcoinTopologyHelper::BitcoinTopologyHelper (uint32_t noCpus, uint32_t totalNoN
     while (m_nodesConnections[i].size() < m_minConnections[i])
     {
       // Choose from publicIP nodes only
-      uint32_t index = rand() % publicIPNodes;
+      uint32_t index = rng.UniformInt (publicIPNodes);
 	    uint32_t candidatePeer = nodes[index];
 
 			if (candidatePeer == i ||
@@ -92,7 +95,7 @@ BitcoinTopologyHelper::BitcoinTopologyHelper (uint32_t noCpus, uint32_t totalNoN
 	// Fill outgoing connections to 8
 	for (int i = 0; i < m_totalNoNodes; i++) {
 		while (outgoingConnectionsCounters[i] < m_minConnections[i]) {
-			uint32_t index = rand() % publicIPNodes;
+			uint32_t index = rng.UniformInt (publicIPNodes);
 			uint32_t candidatePeer = nodes[index];
 			if (candidatePeer == i ||
 					std::find(m_nodesConnections[i].begin(), m_nodesConnections[i].end(), candidatePeer) != m_nodesConnections[i].end() ||
@@ -169,7 +172,8 @@ BitcoinTopologyHelper::BitcoinTopologyHelper (uint32_t noCpus, uint32_t totalNoN
 
   tStart = GetWallTime();
 
-
+  if (messageChannel)
+    m_channel = CreateObject<BitcoinChannel> ();
 
   for(auto &node : m_nodesConnections)
   {
@@ -186,10 +190,14 @@ BitcoinTopologyHelper::BitcoinTopologyHelper (uint32_t noCpus, uint32_t totalNoN
 
         m_totalNoLinks++;
 
-		double bandwidth = std::min(std::min(m_nodesInternetSpeeds[m_nodes.at (node.first).Get (0)->GetId()].uploadSpeed,
-                                    m_nodesInternetSpeeds[m_nodes.at (node.first).Get (0)->GetId()].downloadSpeed),
-                                    std::min(m_nodesInternetSpeeds[m_nodes.at (*it).Get (0)->GetId()].uploadSpeed,
-                                    m_nodesInternetSpeeds[m_nodes.at (*it).Get (0)->GetId()].downloadSpeed));
+        if (m_channel)
+        {
+          // The channel links get their addresses in AssignIpv4Addresses
+          m_channelLinks.push_back (std::make_pair (node.first, *it));
+          continue;
+        }
+
+		double bandwidth = GetLinkBandwidth (m_nodes.at (node.first).Get (0)->GetId(), m_nodes.at (*it).Get (0)->GetId());
 		bandwidthStream.str("");
         bandwidthStream.clear();
 		bandwidthStream << bandwidth << "Mbps";
@@ -224,6 +232,10 @@ BitcoinTopologyHelper::InstallStack (InternetStackHelper stack)
   double tStart = GetWallTime();
   double tFinish;
 
+  // The message channel does not need an internet stack
+  if (m_channel)
+    return;
+
   for (uint32_t i = 0; i < m_nodes.size (); ++i)
     {
       NodeContainer currentNode = m_nodes[i];
@@ -244,6 +256,18 @@ BitcoinTopologyHelper::AssignIpv4Addresses (Ipv4AddressHelperCustom ip)
   double tStart = GetWallTime();
   double tFinish;
 
+  // Allocate the addresses of the channel links without interfaces, one network per link as well
+  for (auto &link : m_channelLinks)
+  {
+    Ipv4Address interfaceAddress1 = ip.NewAddress ();
+    Ipv4Address interfaceAddress2 = ip.NewAddress ();
+
+    AddPeersAddresses (link.first, interfaceAddress1, link.second, interfaceAddress2);
+    m_channel->AddLink (link.first, interfaceAddress1, link.second, interfaceAddress2,
+                        GetLinkBandwidth (link.first, link.second), MilliSeconds (10));
+    ip.NewNetwork ();
+  }
+
   // Assign addresses to all devices in the network.
   // These devices are stored in a vector.
   for (uint32_t i = 0; i < m_devices.size (); ++i)
@@ -265,7 +289,23 @@ BitcoinTopologyHelper::AssignIpv4Addresses (Ipv4AddressHelperCustom ip)
 	  std::cout << "Node " << node1 << "(" << interfaceAddress1 << ") is connected with node  "
                 << node2 << "(" << interfaceAddress2 << ")\n"; */
 
+    AddPeersAddresses (node1, interfaceAddress1, node2, interfaceAddress2);
+
+    ip.NewNetwork ();
+
+    m_interfaces.push_back (newInterfaces);
+  }
+
 
+  tFinish = GetWallTime();
+  if (m_systemId == 0)
+    std::cout << "The Ip addresses have been assigned in " << tFinish - tStart << "s.\n";
+}
+
+
+void
+BitcoinTopologyHelper::AddPeersAddresses (uint32_t node1, Ipv4Address interfaceAddress1, uint32_t node2, Ipv4Address interfaceAddress2)
+{
 	auto node2It = std::find(m_nodesConnections[node1].begin(), m_nodesConnections[node1].end(), node2);
 	if (std::distance(m_nodesConnections[node1].begin(), node2It) < m_minConnections[node1])
 		m_nodesConnectionsIps[node1].insert(m_nodesConnectionsIps[node1].begin(), interfaceAddress2);
@@ -278,20 +318,18 @@ BitcoinTopologyHelper::AssignIpv4Addresses (Ipv4AddressHelperCustom ip)
 	else
 		m_nodesConnectionsIps[node2].push_back(interfaceAddress1);
 
-    ip.NewNetwork ();
-
-    m_interfaces.push_back (newInterfaces);
-
 	m_peersDownloadSpeeds[node1][interfaceAddress2] = m_nodesInternetSpeeds[node2].downloadSpeed;
 	m_peersDownloadSpeeds[node2][interfaceAddress1] = m_nodesInternetSpeeds[node1].downloadSpeed;
 	m_peersUploadSpeeds[node1][interfaceAddress2] = m_nodesInternetSpeeds[node2].uploadSpeed;
 	m_peersUploadSpeeds[node2][interfaceAddress1] = m_nodesInternetSpeeds[node1].uploadSpeed;
-  }
+}
 
 
-  tFinish = GetWallTime();
-  if (m_systemId == 0)
-    std::cout << "The Ip addresses have been assigned in " << tFinish - tStart << "s.\n";
+double
+BitcoinTopologyHelper::GetLinkBandwidth (uint32_t node1, uint32_t node2)
+{
+  return std::min(std::min(m_nodesInternetSpeeds[node1].uploadSpeed, m_nodesInternetSpeeds[node1].downloadSpeed),
+                  std::min(m_nodesInternetSpeeds[node2].uploadSpeed, m_nodesInternetSpeeds[node2].downloadSpeed));
 }
 
 
@@ -355,6 +393,13 @@ BitcoinTopologyHelper::GetNodesInternetSpeeds (void) const
   return m_nodesInternetSpeeds;
 }
 
+
+Ptr<BitcoinChannel>
+BitcoinTopologyHelper::GetChannel (void) const
+{
+  return m_channel;
+}
+
 } // namespace ns3
 
 static double GetWallTime()
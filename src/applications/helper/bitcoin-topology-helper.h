@@ -30,6 +30,7 @@
 #include "net-device-container.h"
 #include "ipv4-address-helper-custom.h"
 #include "ns3/bitcoin.h"
+#include "ns3/bitcoin-channel.h"
 #include <random>
 
 namespace ns3 {
@@ -54,9 +55,13 @@ public:
    * \param pointToPoint the PointToPointHelper which is used
    *                     to connect all of the nodes together
    *                     in the grid
+   *
+   * \param messageChannel connect the nodes through a BitcoinChannel instead
+   *                       of point-to-point links and an internet stack
    */
   BitcoinTopologyHelper (uint32_t noCpus, uint32_t totalNoNodes, uint32_t publicIPNodes,
-    int minConnectionsPerNode, int maxConnectionsPerNode, uint32_t systemId);
+    int minConnectionsPerNode, int maxConnectionsPerNode, uint32_t systemId,
+    bool messageChannel = false);
 
   ~BitcoinTopologyHelper ();
 
@@ -133,8 +138,24 @@ public:
 
    std::map<uint32_t, nodeInternetSpeeds> GetNodesInternetSpeeds (void) const;
 
+  /**
+   * \returns the BitcoinChannel connecting the nodes, or 0 if they are connected
+   *          with point-to-point links
+   */
+   Ptr<BitcoinChannel> GetChannel (void) const;
+
 private:
 
+  /**
+   * \returns the bandwidth of a link in Mbps, limited by the slowest speed of its nodes
+   */
+  double GetLinkBandwidth (uint32_t node1, uint32_t node2);
+
+  /**
+   * Records the addresses of a new link in the connections and the speeds of the peers
+   */
+  void AddPeersAddresses (uint32_t node1, Ipv4Address interfaceAddress1, uint32_t node2, Ipv4Address interfaceAddress2);
+
 
   uint32_t     m_totalNoNodes;                  //!< The total number of nodes
   uint32_t     m_noCpus;                        //!< The number of the available cpus in the simulation
@@ -151,6 +172,8 @@ private:
   std::vector<NodeContainer>                      m_nodes;                   //!< all the nodes in the network
   std::vector<NetDeviceContainer>                 m_devices;                 //!< NetDevices in the network
   std::vector<Ipv4InterfaceContainer>             m_interfaces;              //!< IPv4 interfaces in the network
+  std::vector<std::pair<uint32_t, uint32_t>>      m_channelLinks;            //!< The links of the message channel
+  Ptr<BitcoinChannel>                             m_channel;                 //!< 0 when the point-to-point links are used
 
 
   std::map<uint32_t, std::map<Ipv4Address, double>>    m_peersDownloadSpeeds;     //!< key1 = nodeId, key2 = Ipv4Address of peer
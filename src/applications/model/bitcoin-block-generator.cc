@@ -0,0 +1,127 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-block-generator.h
+ */
+
+#include <math.h>
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "bitcoin-block-generator.h"
+#include "bitcoin-node.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BitcoinBlockGenerator");
+
+NS_OBJECT_ENSURE_REGISTERED (BitcoinBlockGenerator);
+
+TypeId
+BitcoinBlockGenerator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BitcoinBlockGenerator")
+    .SetParent<Object> ()
+    .SetGroupName("Applications")
+    .AddConstructor<BitcoinBlockGenerator> ()
+  ;
+  return tid;
+}
+
+BitcoinBlockGenerator::BitcoinBlockGenerator (void) : m_interval (Seconds (600))
+{
+  NS_LOG_FUNCTION (this);
+  m_rng.SetStream (BitcoinRng::BLOCK_GENERATOR_STREAM);
+}
+
+BitcoinBlockGenerator::~BitcoinBlockGenerator (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BitcoinBlockGenerator::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_nextBlock);
+  m_nodes.clear ();
+  Object::DoDispose ();
+}
+
+void
+BitcoinBlockGenerator::SetMiners (const std::vector<uint32_t> &miners)
+{
+  NS_LOG_FUNCTION (this);
+  m_miners = miners;
+  m_minerNumbers.clear ();
+  for (uint32_t i = 0; i < m_miners.size (); i++)
+    m_minerNumbers[m_miners[i]] = i;
+  m_nodes.assign (m_miners.size (), 0);
+}
+
+void
+BitcoinBlockGenerator::SetInterval (Time interval)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (interval.IsStrictlyPositive (), "The block interval must be positive");
+  m_interval = interval;
+}
+
+void
+BitcoinBlockGenerator::Start (Time start, Time stop)
+{
+  NS_LOG_FUNCTION (this << start << stop);
+  m_stop = stop;
+  m_minedTimes.clear ();
+
+  if (m_miners.empty ())
+    return;
+
+  double delay = (start - Simulator::Now ()).GetSeconds () - log (1 - m_rng.UniformReal ()) * m_interval.GetSeconds ();
+  if (Simulator::Now () + Seconds (delay) <= m_stop)
+    m_nextBlock = Simulator::Schedule (Seconds (delay), &BitcoinBlockGenerator::Mine, this);
+}
+
+bool
+BitcoinBlockGenerator::IsMiner (uint32_t nodeId) const
+{
+  return m_minerNumbers.find (nodeId) != m_minerNumbers.end ();
+}
+
+void
+BitcoinBlockGenerator::Attach (uint32_t nodeId, BitcoinNode *node)
+{
+  auto it = m_minerNumbers.find (nodeId);
+  if (it != m_minerNumbers.end ())
+    m_nodes[it->second] = node;
+}
+
+void
+BitcoinBlockGenerator::Detach (uint32_t nodeId)
+{
+  auto it = m_minerNumbers.find (nodeId);
+  if (it != m_minerNumbers.end ())
+    m_nodes[it->second] = 0;
+}
+
+void
+BitcoinBlockGenerator::ScheduleNext (void)
+{
+  Time delay = Seconds (-log (1 - m_rng.UniformReal ()) * m_interval.GetSeconds ());
+  if (Simulator::Now () + delay <= m_stop)
+    m_nextBlock = Simulator::Schedule (delay, &BitcoinBlockGenerator::Mine, this);
+}
+
+void
+BitcoinBlockGenerator::Mine (void)
+{
+  NS_LOG_FUNCTION (this);
+  int block = m_minedTimes.size ();
+  m_minedTimes.push_back (Simulator::Now ().GetSeconds ());
+
+  // Every rank draws the same miner, and the rank which runs it builds the block
+  BitcoinNode *node = m_nodes[m_rng.UniformInt (m_miners.size ())];
+  if (node)
+    node->MineBlock (block);
+
+  ScheduleNext ();
+}
+
+} // Namespace ns3
@@ -0,0 +1,104 @@
+/**
+ * This file declares the BitcoinBlockGenerator class, which mines the blocks of the simulation.
+ */
+
+#ifndef BITCOIN_BLOCK_GENERATOR_H
+#define BITCOIN_BLOCK_GENERATOR_H
+
+#include <vector>
+#include <unordered_map>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "bitcoin-rng.h"
+
+namespace ns3 {
+
+class BitcoinNode;
+
+
+/**
+ * Mines the blocks of the whole network as a single Poisson process of mean interval, and hands
+ * each block to a miner chosen uniformly, i.e. the miners share the hash rate evenly.
+ *
+ * Blocks are numbered from 0 in the order they are mined. The generator draws from its own
+ * BitcoinRng stream, so every MPI rank replays the same blocks and knows when each of them was
+ * mined, while only the rank of the chosen miner builds the block.
+ */
+class BitcoinBlockGenerator : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+  BitcoinBlockGenerator (void);
+  virtual ~BitcoinBlockGenerator (void);
+
+  /**
+   * \brief Sets the nodes which mine blocks
+   * \param miners the node ids of the miners, in the same order on every rank
+   */
+  void SetMiners (const std::vector<uint32_t> &miners);
+
+  /**
+   * \brief Sets the mean time between two blocks of the network
+   */
+  void SetInterval (Time interval);
+
+  /**
+   * \brief Schedules the blocks
+   * \param start the time mining starts at
+   * \param stop the time after which no block is mined
+   */
+  void Start (Time start, Time stop);
+
+  /**
+   * \return true if the node is a miner
+   */
+  bool IsMiner (uint32_t nodeId) const;
+
+  /**
+   * \brief Lets a miner build the blocks it finds
+   * \param nodeId the id of the node
+   * \param node the application of the node
+   */
+  void Attach (uint32_t nodeId, BitcoinNode *node);
+
+  /**
+   * \brief Stops handing blocks to a node
+   * \param nodeId the id of the node
+   */
+  void Detach (uint32_t nodeId);
+
+  /**
+   * \return the number of blocks mined so far in the whole network
+   */
+  uint32_t GetBlocks (void) const { return m_minedTimes.size (); }
+
+  /**
+   * \return the time a block was mined at, in seconds
+   */
+  double GetMinedTime (int block) const { return m_minedTimes[block]; }
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void Mine (void);
+
+  /**
+   * \brief Schedules the next block after now, unless it comes after the stop time
+   */
+  void ScheduleNext (void);
+
+  std::vector<uint32_t>                     m_miners;                 //!< The node id of each miner
+  std::unordered_map<uint32_t, uint32_t>    m_minerNumbers;           //!< The number of each miner by node id
+  std::vector<BitcoinNode*>                 m_nodes;                  //!< The attached node of each miner, 0 on other ranks
+  std::vector<double>                       m_minedTimes;             //!< The time each block was mined at
+  Time                                      m_interval;
+  Time                                      m_stop;
+  BitcoinRng                                m_rng;
+  EventId                                   m_nextBlock;
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_BLOCK_GENERATOR_H */
@@ -0,0 +1,135 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-channel.h
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/uinteger.h"
+#include "bitcoin-channel.h"
+#include "bitcoin-node.h"
+#include "bitcoin-trace.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BitcoinChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (BitcoinChannel);
+
+TypeId
+BitcoinChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BitcoinChannel")
+    .SetParent<Object> ()
+    .SetGroupName("Applications")
+    .AddConstructor<BitcoinChannel> ()
+    .AddAttribute ("Port",
+                   "The port reported as the source of the delivered messages.",
+                   UintegerValue (8333),
+                   MakeUintegerAccessor (&BitcoinChannel::m_port),
+                   MakeUintegerChecker<uint16_t> ())
+  ;
+  return tid;
+}
+
+BitcoinChannel::BitcoinChannel (void) : m_nLinks (0), m_port (8333)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BitcoinChannel::~BitcoinChannel (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BitcoinChannel::AddLink (uint32_t nodeA, Ipv4Address addressA, uint32_t nodeB, Ipv4Address addressB,
+                         double bandwidthMbps, Time latency)
+{
+  NS_LOG_FUNCTION (this << nodeA << addressA << nodeB << addressB << bandwidthMbps);
+
+  uint32_t maxId = std::max (nodeA, nodeB);
+  if (maxId >= m_links.size ())
+  {
+    m_links.resize (maxId + 1);
+    m_nodes.resize (maxId + 1, 0);
+  }
+
+  channelLink link;
+  link.bytesPerSecond = bandwidthMbps * 1000000 / 8;
+  link.latency = latency;
+  link.busyUntil = Seconds (0);
+
+  link.peer = nodeB;
+  link.localAddress = addressA;
+  m_links[nodeA][addressB.Get ()] = link;
+
+  link.peer = nodeA;
+  link.localAddress = addressB;
+  m_links[nodeB][addressA.Get ()] = link;
+
+  m_nLinks++;
+}
+
+void
+BitcoinChannel::Attach (uint32_t nodeId, BitcoinNode *node)
+{
+  NS_LOG_FUNCTION (this << nodeId);
+
+  if (nodeId >= m_nodes.size ())
+  {
+    m_links.resize (nodeId + 1);
+    m_nodes.resize (nodeId + 1, 0);
+  }
+  m_nodes[nodeId] = node;
+}
+
+void
+BitcoinChannel::Detach (uint32_t nodeId)
+{
+  NS_LOG_FUNCTION (this << nodeId);
+
+  if (nodeId < m_nodes.size ())
+    m_nodes[nodeId] = 0;
+}
+
+void
+BitcoinChannel::Send (uint32_t sender, Ipv4Address receiver, const bitcoinMessage &msg, uint32_t size)
+{
+  NS_LOG_FUNCTION (this << sender << receiver << size);
+
+  auto it = m_links.at (sender).find (receiver.Get ());
+  if (it == m_links[sender].end ())
+  {
+    BITCOIN_TRACE_WARN ("Node " << sender << " is not linked with " << receiver);
+    return;
+  }
+
+  channelLink &link = it->second;
+  Time now = Simulator::Now ();
+  Time departure = std::max (now, link.busyUntil);
+
+  if (link.bytesPerSecond > 0)
+    departure += Seconds (size / link.bytesPerSecond);
+  link.busyUntil = departure;
+
+  Simulator::ScheduleWithContext (link.peer, departure - now + link.latency,
+                                  &BitcoinChannel::Deliver, this, link.peer, msg, link.localAddress);
+}
+
+void
+BitcoinChannel::Deliver (uint32_t receiver, bitcoinMessage msg, Ipv4Address from)
+{
+  if (m_nodes[receiver] == 0)
+    return;
+
+  m_nodes[receiver]->HandleMessage (msg, InetSocketAddress (from, m_port));
+}
+
+uint32_t
+BitcoinChannel::GetNLinks (void) const
+{
+  return m_nLinks;
+}
+
+} // Namespace ns3
@@ -0,0 +1,98 @@
+/**
+ * This file declares the BitcoinChannel class, a lightweight transport which carries
+ * bitcoinMessages between BitcoinNodes without sockets, TCP or point-to-point devices.
+ */
+
+#ifndef BITCOIN_CHANNEL_H
+#define BITCOIN_CHANNEL_H
+
+#include <vector>
+#include <unordered_map>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/ipv4-address.h"
+#include "bitcoin-message.h"
+
+namespace ns3 {
+
+class BitcoinNode;
+
+
+/**
+ * Connects the peers of every link of the topology directly. A message is handed to the
+ * channel by the sending node and delivered to the HandleMessage method of the receiving
+ * node after the serialization delay, given by the link bandwidth and the messages already
+ * queued on the same direction of the link, plus the link latency.
+ *
+ * Every node keeps its Ipv4 addresses, one per link, so the protocol logic and the statistics
+ * of BitcoinNode stay the same. The channel only works within a single MPI rank.
+ */
+class BitcoinChannel : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+  BitcoinChannel (void);
+  virtual ~BitcoinChannel (void);
+
+  /**
+   * \brief Adds a link between two nodes
+   * \param nodeA the id of the first node
+   * \param addressA the address of the first node on this link
+   * \param nodeB the id of the second node
+   * \param addressB the address of the second node on this link
+   * \param bandwidthMbps the bandwidth of each direction in Mbps. 0 stands for an unlimited bandwidth.
+   * \param latency the one-way latency
+   */
+  void AddLink (uint32_t nodeA, Ipv4Address addressA, uint32_t nodeB, Ipv4Address addressB,
+                double bandwidthMbps, Time latency);
+
+  /**
+   * \brief Starts delivering messages to a node
+   * \param nodeId the id of the node
+   * \param node the application of the node
+   */
+  void Attach (uint32_t nodeId, BitcoinNode *node);
+
+  /**
+   * \brief Stops delivering messages to a node. Messages in flight towards it are dropped.
+   * \param nodeId the id of the node
+   */
+  void Detach (uint32_t nodeId);
+
+  /**
+   * \brief Sends a message over the link which connects a node to a peer
+   * \param sender the id of the sending node
+   * \param receiver the address of the peer
+   * \param msg the message
+   * \param size the number of bytes the message occupies on the link
+   */
+  void Send (uint32_t sender, Ipv4Address receiver, const bitcoinMessage &msg, uint32_t size);
+
+  /**
+   * \return the number of links
+   */
+  uint32_t GetNLinks (void) const;
+
+private:
+  /**
+   * One direction of a link, as seen by the sending node
+   */
+  typedef struct {
+    uint32_t    peer;                //!< The id of the receiving node
+    Ipv4Address localAddress;        //!< The address of the sending node on the link
+    double      bytesPerSecond;      //!< 0 for an unlimited bandwidth
+    Time        latency;
+    Time        busyUntil;           //!< The time the last queued message finishes its serialization
+  } channelLink;
+
+  void Deliver (uint32_t receiver, bitcoinMessage msg, Ipv4Address from);
+
+  std::vector<std::unordered_map<uint32_t, channelLink>>  m_links;      //!< key1 = nodeId, key2 = Ipv4Address of peer
+  std::vector<BitcoinNode*>                               m_nodes;      //!< key = nodeId, 0 when not attached
+  uint32_t                                                m_nLinks;
+  uint16_t                                                m_port;       //!< The port reported as the source of delivered messages
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_CHANNEL_H */
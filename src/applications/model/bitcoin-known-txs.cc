@@ -0,0 +1,86 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-known-txs.h
+ */
+
+#include "bitcoin-known-txs.h"
+
+namespace ns3 {
+
+const uint32_t KnownTxSet::EMPTY_KEY;
+
+static const size_t INITIAL_BUCKETS = 16;
+
+KnownTxSet::KnownTxSet (void) : m_shift (28), m_usedBuckets (0), m_size (0)
+{
+  bucket empty = {EMPTY_KEY, 0};
+  m_buckets.assign (INITIAL_BUCKETS, empty);
+}
+
+size_t
+KnownTxSet::FindBucket (uint32_t key) const
+{
+  // Fibonacci hashing spreads the consecutive keys of an origin over the table
+  size_t mask = m_buckets.size() - 1;
+  size_t i = uint32_t(key * 2654435769u) >> m_shift;
+
+  while (m_buckets[i].key != key && m_buckets[i].key != EMPTY_KEY)
+    i = (i + 1) & mask;
+  return i;
+}
+
+bool
+KnownTxSet::Contains (int txId) const
+{
+  const bucket &b = m_buckets[FindBucket (uint32_t(txId) / 32)];
+  return b.key != EMPTY_KEY && (b.bits & (1u << (uint32_t(txId) % 32)));
+}
+
+bool
+KnownTxSet::Insert (int txId)
+{
+  uint32_t key = uint32_t(txId) / 32;
+  uint32_t bit = 1u << (uint32_t(txId) % 32);
+  size_t i = FindBucket (key);
+
+  if (m_buckets[i].key == EMPTY_KEY)
+  {
+    if (2 * (m_usedBuckets + 1) > m_buckets.size())
+    {
+      Grow ();
+      i = FindBucket (key);
+    }
+    m_buckets[i].key = key;
+    m_usedBuckets++;
+  }
+  else if (m_buckets[i].bits & bit)
+    return false;
+
+  m_buckets[i].bits |= bit;
+  m_size++;
+  return true;
+}
+
+void
+KnownTxSet::Grow (void)
+{
+  std::vector<bucket> old;
+  bucket empty = {EMPTY_KEY, 0};
+
+  old.swap (m_buckets);
+  m_buckets.assign (2 * old.size(), empty);
+  m_shift--;
+
+  for (const bucket &b: old)
+  {
+    if (b.key != EMPTY_KEY)
+      m_buckets[FindBucket (b.key)] = b;
+  }
+}
+
+size_t
+KnownTxSet::GetMemoryUsage (void) const
+{
+  return sizeof (*this) + m_buckets.capacity() * sizeof (bucket);
+}
+
+} // Namespace ns3
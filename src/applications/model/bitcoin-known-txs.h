@@ -0,0 +1,71 @@
+/**
+ * This file declares the KnownTxSet class, which holds the transactions a node has already seen.
+ */
+
+#ifndef BITCOIN_KNOWN_TXS_H
+#define BITCOIN_KNOWN_TXS_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * A set of transaction ids with O(1) insertions and lookups.
+ *
+ * Transaction ids are the dense indices of BitcoinTxRegistry, in the order of creation, so 32
+ * consecutive ids are transactions created at about the same time. The set stores a 32 bit bitmap
+ * of the ids per txId / 32 in an open-addressing hash table with linear probing. The table grows by doubling and is never more than half full, and a bucket takes 8 Bytes
+ * whatever the number of transactions it holds.
+ */
+class KnownTxSet
+{
+public:
+  KnownTxSet (void);
+
+  /**
+   * \brief Checks whether a transaction is in the set
+   * \param txId the non-negative transaction id
+   * \return true if the transaction was inserted
+   */
+  bool Contains (int txId) const;
+
+  /**
+   * \brief Inserts a transaction
+   * \param txId the non-negative transaction id
+   * \return false if the transaction was already in the set
+   */
+  bool Insert (int txId);
+
+  size_t Size (void) const { return m_size; }
+
+  /**
+   * \return the bytes of memory held by the hash table
+   */
+  size_t GetMemoryUsage (void) const;
+
+private:
+  typedef struct {
+    uint32_t key;        //!< txId / 32, EMPTY_KEY for a free bucket
+    uint32_t bits;       //!< Bit txId % 32 is set for every transaction of the bucket
+  } bucket;
+
+  static const uint32_t EMPTY_KEY = 0xffffffff;
+
+  /**
+   * \return the bucket which holds the key, or the free bucket where it belongs
+   */
+  size_t FindBucket (uint32_t key) const;
+
+  void Grow (void);
+
+  std::vector<bucket> m_buckets;        //!< A power of two buckets
+  uint32_t            m_shift;          //!< 32 - log2 of the number of buckets
+  size_t              m_usedBuckets;
+  size_t              m_size;           //!< The number of transactions
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_KNOWN_TXS_H */
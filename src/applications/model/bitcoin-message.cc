@@ -0,0 +1,685 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-message.h
+ */
+
+#include <cstring>
+#include <algorithm>
+#include "ns3/log.h"
+#include "bitcoin-message.h"
+#include "../../rapidjson/document.h"
+#include "../../rapidjson/writer.h"
+#include "../../rapidjson/stringbuffer.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BitcoinHeader);
+
+static void
+PutU32 (std::string &out, uint32_t value)
+{
+  char bytes[4] = {char(value & 0xff), char((value >> 8) & 0xff), char((value >> 16) & 0xff), char((value >> 24) & 0xff)};
+  out.append (bytes, 4);
+}
+
+static uint32_t
+GetU32 (const char *data)
+{
+  const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+  return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+}
+
+static void
+EncodeJson (const bitcoinMessage &msg, std::string &out)
+{
+  /**
+   * Build the same documents, with the same member order, as the nodes used to.
+   */
+  rapidjson::Document d;
+  rapidjson::Document::AllocatorType& allocator = d.GetAllocator();
+  rapidjson::Value value;
+
+  d.SetObject();
+  value = msg.type;
+  d.AddMember("message", value, allocator);
+
+  switch (msg.type)
+  {
+    case INV:
+    case DANDELION_TX:
+    {
+      rapidjson::Value array(rapidjson::kArrayType);
+      for (int tx: msg.txs)
+      {
+        value.SetInt(tx);
+        array.PushBack(value, allocator);
+      }
+      d.AddMember("inv", array, allocator);
+      value = msg.hop;
+      d.AddMember("hop", value, allocator);
+      break;
+    }
+    case MODE:
+    {
+      value.SetInt(msg.mode);
+      d.AddMember("mode", value, allocator);
+      break;
+    }
+    case RECONCILE_TX_REQUEST:
+    {
+      value.SetInt(msg.setSize);
+      d.AddMember("setSize", value, allocator);
+      break;
+    }
+    case FILTER_REQUEST:
+    {
+      value.SetInt(msg.filterBegin);
+      d.AddMember("filterBegin", value, allocator);
+      value.SetInt(msg.filterEnd);
+      d.AddMember("filterEnd", value, allocator);
+      break;
+    }
+    case UPDATE_FILTER_BEGIN:
+    {
+      value.SetInt(msg.filterBegin);
+      d.AddMember("filterBegin", value, allocator);
+      break;
+    }
+    case UPDATE_FILTER_END:
+    {
+      value.SetInt(msg.filterEnd);
+      d.AddMember("filterEnd", value, allocator);
+      break;
+    }
+    case RECONCILE_TX_RESPONSE:
+    {
+      rapidjson::Value array(rapidjson::kArrayType);
+      for (int tx: msg.txs)
+      {
+        value.SetInt(tx);
+        array.PushBack(value, allocator);
+      }
+      d.AddMember("transactions", array, allocator);
+      break;
+    }
+    case RECONCILE_SKETCH:
+    case RECONCILE_BISECTION_SKETCH:
+    {
+      rapidjson::Value array(rapidjson::kArrayType);
+      for (uint32_t syndrome: msg.sketch)
+      {
+        value.SetUint(syndrome);
+        array.PushBack(value, allocator);
+      }
+      d.AddMember("sketch", array, allocator);
+      value.SetInt(msg.setSize);
+      d.AddMember("setSize", value, allocator);
+      break;
+    }
+    case RECONCILE_DIFF:
+    {
+      rapidjson::Value array(rapidjson::kArrayType);
+      for (int tx: msg.txs)
+      {
+        value.SetInt(tx);
+        array.PushBack(value, allocator);
+      }
+      d.AddMember("transactions", array, allocator);
+      value.SetInt(msg.setSize);
+      d.AddMember("setSize", value, allocator);
+      break;
+    }
+    case CMPCT_BLOCK:
+    case GET_BLOCK_TXN:
+    case BLOCK_TXN:
+    {
+      rapidjson::Value array(rapidjson::kArrayType);
+      for (int tx: msg.txs)
+      {
+        value.SetInt(tx);
+        array.PushBack(value, allocator);
+      }
+      d.AddMember("transactions", array, allocator);
+      value.SetInt(msg.block);
+      d.AddMember("block", value, allocator);
+      break;
+    }
+    default:
+      break;
+  }
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  d.Accept(writer);
+
+  // The null terminator is sent along, so that the receiver can parse the document in place
+  PutU32 (out, buffer.GetSize() + 1);
+  out.append (buffer.GetString(), buffer.GetSize());
+  out.push_back ('\0');
+}
+
+static void
+EncodeBinary (const bitcoinMessage &msg, std::string &out)
+{
+  size_t headerPos = out.size();
+  char header[BINARY_HEADER_SIZE] = {char(msg.type), 0, 0, 0, 0, 0, 0, 0};
+
+  if (msg.type == INV || msg.type == DANDELION_TX)
+  {
+    header[2] = char(msg.hop & 0xff);
+    header[3] = char((msg.hop >> 8) & 0xff);
+  }
+  out.append (header, BINARY_HEADER_SIZE);
+
+  switch (msg.type)
+  {
+    case INV:
+    case DANDELION_TX:
+    case RECONCILE_TX_RESPONSE:
+    {
+      PutU32 (out, msg.txs.size());
+      for (int tx: msg.txs)
+        PutU32 (out, uint32_t(tx));
+      break;
+    }
+    case MODE:
+      PutU32 (out, uint32_t(msg.mode));
+      break;
+    case RECONCILE_TX_REQUEST:
+      PutU32 (out, uint32_t(msg.setSize));
+      break;
+    case FILTER_REQUEST:
+      PutU32 (out, uint32_t(msg.filterBegin));
+      PutU32 (out, uint32_t(msg.filterEnd));
+      break;
+    case UPDATE_FILTER_BEGIN:
+      PutU32 (out, uint32_t(msg.filterBegin));
+      break;
+    case UPDATE_FILTER_END:
+      PutU32 (out, uint32_t(msg.filterEnd));
+      break;
+    case RECONCILE_SKETCH:
+    case RECONCILE_BISECTION_SKETCH:
+    {
+      PutU32 (out, uint32_t(msg.setSize));
+      PutU32 (out, msg.sketch.size());
+      for (uint32_t syndrome: msg.sketch)
+        PutU32 (out, syndrome);
+      break;
+    }
+    case RECONCILE_DIFF:
+    {
+      PutU32 (out, uint32_t(msg.setSize));
+      PutU32 (out, msg.txs.size());
+      for (int tx: msg.txs)
+        PutU32 (out, uint32_t(tx));
+      break;
+    }
+    case CMPCT_BLOCK:
+    case GET_BLOCK_TXN:
+    case BLOCK_TXN:
+    {
+      PutU32 (out, uint32_t(msg.block));
+      PutU32 (out, msg.txs.size());
+      for (int tx: msg.txs)
+        PutU32 (out, uint32_t(tx));
+      break;
+    }
+    default:
+      break;
+  }
+
+  uint32_t payloadSize = out.size() - headerPos - BINARY_HEADER_SIZE;
+  for (int i = 0; i < 4; i++)
+    out[headerPos + 4 + i] = char((payloadSize >> (8 * i)) & 0xff);
+}
+
+void
+BitcoinCodec::Encode (const bitcoinMessage &msg, enum WireFormat format, std::string &out)
+{
+  if (format == JSON_WIRE)
+    EncodeJson (msg, out);
+  else
+    EncodeBinary (msg, out);
+}
+
+/**
+ * The size of the fixed part of a frame, which ends with the frame length
+ */
+static size_t
+FrameHeaderSize (enum WireFormat format)
+{
+  return format == JSON_WIRE ? JSON_PREFIX_SIZE : BINARY_HEADER_SIZE;
+}
+
+static size_t
+FrameSize (const char *data, enum WireFormat format)
+{
+  size_t headerSize = FrameHeaderSize (format);
+  return headerSize + GetU32 (data + headerSize - 4);
+}
+
+bool
+BitcoinCodec::NextFrame (const char *data, size_t size, enum WireFormat format, size_t &frameSize)
+{
+  if (size < FrameHeaderSize (format))
+    return false;
+  frameSize = FrameSize (data, format);
+  return size >= frameSize;
+}
+
+uint32_t
+BitcoinCodec::BytesMissing (const char *data, size_t size)
+{
+  if (size < BINARY_HEADER_SIZE)
+    return BINARY_HEADER_SIZE - size;
+  return FrameSize (data, VIRTUAL_WIRE) - size;
+}
+
+uint32_t
+BitcoinCodec::PaddingSize (const char *data, size_t size)
+{
+  return GetU32 (data + size - 4);
+}
+
+static bool
+DecodeJson (const char *data, bitcoinMessage &msg)
+{
+  rapidjson::Document d;
+  d.Parse(data);
+
+  if (!d.IsObject())
+    return false;
+
+  msg.type = Messages(d["message"].GetInt());
+  msg.txs.clear();
+  msg.sketch.clear();
+  switch (msg.type)
+  {
+    case INV:
+    case DANDELION_TX:
+    {
+      for (rapidjson::Value::ConstValueIterator itr = d["inv"].Begin(); itr != d["inv"].End(); ++itr)
+        msg.txs.push_back(itr->GetInt());
+      msg.hop = d["hop"].GetInt();
+      break;
+    }
+    case MODE:
+      msg.mode = d["mode"].GetInt();
+      break;
+    case RECONCILE_TX_REQUEST:
+      msg.setSize = d["setSize"].GetInt();
+      break;
+    case FILTER_REQUEST:
+      msg.filterBegin = d["filterBegin"].GetInt();
+      msg.filterEnd = d["filterEnd"].GetInt();
+      break;
+    case UPDATE_FILTER_BEGIN:
+      msg.filterBegin = d["filterBegin"].GetInt();
+      break;
+    case UPDATE_FILTER_END:
+      msg.filterEnd = d["filterEnd"].GetInt();
+      break;
+    case RECONCILE_TX_RESPONSE:
+    {
+      for (rapidjson::Value::ConstValueIterator itr = d["transactions"].Begin(); itr != d["transactions"].End(); ++itr)
+        msg.txs.push_back(itr->GetInt());
+      break;
+    }
+    case RECONCILE_SKETCH:
+    case RECONCILE_BISECTION_SKETCH:
+    {
+      for (rapidjson::Value::ConstValueIterator itr = d["sketch"].Begin(); itr != d["sketch"].End(); ++itr)
+        msg.sketch.push_back(itr->GetUint());
+      msg.setSize = d["setSize"].GetInt();
+      break;
+    }
+    case RECONCILE_DIFF:
+    {
+      for (rapidjson::Value::ConstValueIterator itr = d["transactions"].Begin(); itr != d["transactions"].End(); ++itr)
+        msg.txs.push_back(itr->GetInt());
+      msg.setSize = d["setSize"].GetInt();
+      break;
+    }
+    case CMPCT_BLOCK:
+    case GET_BLOCK_TXN:
+    case BLOCK_TXN:
+    {
+      for (rapidjson::Value::ConstValueIterator itr = d["transactions"].Begin(); itr != d["transactions"].End(); ++itr)
+        msg.txs.push_back(itr->GetInt());
+      msg.block = d["block"].GetInt();
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
+
+static bool
+DecodeBinary (const char *data, size_t size, bitcoinMessage &msg)
+{
+  const uint8_t *header = reinterpret_cast<const uint8_t*>(data);
+  const char *payload = data + BINARY_HEADER_SIZE;
+  size_t payloadSize = size - BINARY_HEADER_SIZE;
+
+  msg.type = Messages(header[0]);
+  msg.hop = header[2] | (header[3] << 8);
+  msg.txs.clear();
+  msg.sketch.clear();
+  switch (msg.type)
+  {
+    case INV:
+    case DANDELION_TX:
+    case RECONCILE_TX_RESPONSE:
+    {
+      if (payloadSize < 4)
+        return false;
+      uint32_t count = GetU32 (payload);
+      if (payloadSize != 4 + 4 * size_t(count))
+        return false;
+      msg.txs.reserve(count);
+      for (uint32_t i = 0; i < count; i++)
+        msg.txs.push_back(int(GetU32 (payload + 4 + 4 * i)));
+      break;
+    }
+    case MODE:
+      if (payloadSize != 4)
+        return false;
+      msg.mode = int(GetU32 (payload));
+      break;
+    case RECONCILE_TX_REQUEST:
+      if (payloadSize != 4)
+        return false;
+      msg.setSize = int(GetU32 (payload));
+      break;
+    case FILTER_REQUEST:
+      if (payloadSize != 8)
+        return false;
+      msg.filterBegin = int(GetU32 (payload));
+      msg.filterEnd = int(GetU32 (payload + 4));
+      break;
+    case UPDATE_FILTER_BEGIN:
+      if (payloadSize != 4)
+        return false;
+      msg.filterBegin = int(GetU32 (payload));
+      break;
+    case UPDATE_FILTER_END:
+      if (payloadSize != 4)
+        return false;
+      msg.filterEnd = int(GetU32 (payload));
+      break;
+    case RECONCILE_SKETCH:
+    case RECONCILE_BISECTION_SKETCH:
+    case RECONCILE_DIFF:
+    {
+      if (payloadSize < 8)
+        return false;
+      msg.setSize = int(GetU32 (payload));
+      uint32_t count = GetU32 (payload + 4);
+      if (payloadSize != 8 + 4 * size_t(count))
+        return false;
+      for (uint32_t i = 0; i < count; i++)
+      {
+        uint32_t item = GetU32 (payload + 8 + 4 * i);
+        if (msg.type == RECONCILE_DIFF)
+          msg.txs.push_back(int(item));
+        else
+          msg.sketch.push_back(item);
+      }
+      break;
+    }
+    case CMPCT_BLOCK:
+    case GET_BLOCK_TXN:
+    case BLOCK_TXN:
+    {
+      if (payloadSize < 8)
+        return false;
+      msg.block = int(GetU32 (payload));
+      uint32_t count = GetU32 (payload + 4);
+      if (payloadSize != 8 + 4 * size_t(count))
+        return false;
+      msg.txs.reserve(count);
+      for (uint32_t i = 0; i < count; i++)
+        msg.txs.push_back(int(GetU32 (payload + 8 + 4 * i)));
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
+
+bool
+BitcoinCodec::Decode (const char *data, size_t size, enum WireFormat format, bitcoinMessage &msg)
+{
+  if (format == BINARY_WIRE)
+    return DecodeBinary (data, size, msg);
+  if (format == VIRTUAL_WIRE)
+  {
+    if (size != VIRTUAL_FRAME_SIZE || !BitcoinMessageStore::Get ().Take (GetU32 (data + BINARY_HEADER_SIZE), msg))
+      return false;
+    return msg.type == Messages(uint8_t(data[0]));
+  }
+  if (size <= JSON_PREFIX_SIZE || data[size - 1] != '\0')
+    return false;
+  return DecodeJson (data + JSON_PREFIX_SIZE, msg);
+}
+
+Ptr<Packet>
+BitcoinCodec::EncodeVirtual (const bitcoinMessage &msg, uint32_t payloadSize)
+{
+  uint32_t wireSize = BITCOIN_HEADER_SIZE + payloadSize;
+  uint32_t padding = wireSize > VIRTUAL_FRAME_SIZE ? wireSize - VIRTUAL_FRAME_SIZE : 0;
+
+  Ptr<Packet> packet = Create<Packet> (padding);
+  packet->AddHeader (BitcoinHeader (msg.type, msg.hop, BitcoinMessageStore::Get ().Put (msg), padding));
+  return packet;
+}
+
+ReceiveBuffer::ReceiveBuffer (void) : m_head (0), m_tail (0), m_padding (0)
+{
+}
+
+uint8_t*
+ReceiveBuffer::Reserve (size_t size)
+{
+  if (m_tail + size > m_storage.size())
+  {
+    size_t buffered = Size();
+    if (m_head > 0)
+    {
+      memmove (m_storage.data(), m_storage.data() + m_head, buffered);
+      m_head = 0;
+      m_tail = buffered;
+    }
+    if (buffered + size > m_storage.size())
+      m_storage.resize(std::max(buffered + size, 2 * m_storage.size()));
+  }
+  return reinterpret_cast<uint8_t*>(m_storage.data() + m_tail);
+}
+
+void
+ReceiveBuffer::Commit (size_t size)
+{
+  m_tail += size;
+}
+
+void
+ReceiveBuffer::Consume (size_t size)
+{
+  m_head += size;
+  if (m_head == m_tail)
+    m_head = m_tail = 0;
+}
+
+void
+ReceiveBuffer::ExpectPadding (uint32_t size)
+{
+  m_padding += size;
+}
+
+void
+ReceiveBuffer::DropPadding (uint32_t size)
+{
+  m_padding -= size;
+}
+
+BitcoinMessageStore &
+BitcoinMessageStore::Get (void)
+{
+  static BitcoinMessageStore store;
+  return store;
+}
+
+uint32_t
+BitcoinMessageStore::Put (const bitcoinMessage &msg)
+{
+  uint32_t handle;
+  if (m_free.empty())
+  {
+    handle = m_slots.size();
+    m_slots.push_back(msg);
+    m_used.push_back(true);
+    return handle;
+  }
+  handle = m_free.back();
+  m_free.pop_back();
+  // Assigning the vectors reuses their capacity
+  m_slots[handle] = msg;
+  m_used[handle] = true;
+  return handle;
+}
+
+bool
+BitcoinMessageStore::Take (uint32_t handle, bitcoinMessage &msg)
+{
+  if (handle >= m_slots.size() || !m_used[handle])
+    return false;
+
+  bitcoinMessage &slot = m_slots[handle];
+  msg.type = slot.type;
+  msg.hop = slot.hop;
+  msg.mode = slot.mode;
+  msg.setSize = slot.setSize;
+  msg.filterBegin = slot.filterBegin;
+  msg.filterEnd = slot.filterEnd;
+  msg.block = slot.block;
+  msg.txs.swap(slot.txs);
+  msg.sketch.swap(slot.sketch);
+  m_used[handle] = false;
+  m_free.push_back(handle);
+  return true;
+}
+
+BitcoinHeader::BitcoinHeader (void) : m_type (INV), m_hop (0), m_handle (0), m_padding (0)
+{
+}
+
+BitcoinHeader::BitcoinHeader (enum Messages type, int hop, uint32_t handle, uint32_t padding)
+  : m_type (type), m_hop (hop), m_handle (handle), m_padding (padding)
+{
+}
+
+TypeId
+BitcoinHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BitcoinHeader")
+    .SetParent<Header> ()
+    .SetGroupName("Applications")
+    .AddConstructor<BitcoinHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+BitcoinHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+BitcoinHeader::GetSerializedSize (void) const
+{
+  return VIRTUAL_FRAME_SIZE;
+}
+
+void
+BitcoinHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+
+  i.WriteU8 (m_type);
+  i.WriteU8 (0);
+  i.WriteHtolsbU16 (m_type == INV || m_type == DANDELION_TX ? m_hop : 0);
+  i.WriteHtolsbU32 (VIRTUAL_FRAME_SIZE - BINARY_HEADER_SIZE);
+  i.WriteHtolsbU32 (m_handle);
+  i.WriteHtolsbU32 (m_padding);
+}
+
+uint32_t
+BitcoinHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+
+  m_type = Messages(i.ReadU8 ());
+  i.ReadU8 ();
+  m_hop = i.ReadLsbtohU16 ();
+  i.ReadLsbtohU32 ();
+  m_handle = i.ReadLsbtohU32 ();
+  m_padding = i.ReadLsbtohU32 ();
+  return i.GetDistanceFrom (start);
+}
+
+void
+BitcoinHeader::Print (std::ostream &os) const
+{
+  os << "{message: " << m_type << ", hop: " << m_hop << ", handle: " << m_handle << "} padding: " << m_padding;
+}
+
+std::ostream&
+operator<< (std::ostream &os, const bitcoinMessage &msg)
+{
+  os << "{message: " << msg.type;
+  switch (msg.type)
+  {
+    case INV:
+    case DANDELION_TX:
+      os << ", hop: " << msg.hop << ", inv: " << msg.txs.size() << " items";
+      break;
+    case MODE:
+      os << ", mode: " << msg.mode;
+      break;
+    case RECONCILE_TX_REQUEST:
+      os << ", setSize: " << msg.setSize;
+      break;
+    case FILTER_REQUEST:
+      os << ", filter: [" << msg.filterBegin << ", " << msg.filterEnd << ")";
+      break;
+    case UPDATE_FILTER_BEGIN:
+      os << ", filterBegin: " << msg.filterBegin;
+      break;
+    case UPDATE_FILTER_END:
+      os << ", filterEnd: " << msg.filterEnd;
+      break;
+    case RECONCILE_TX_RESPONSE:
+      os << ", transactions: " << msg.txs.size() << " items";
+      break;
+    case RECONCILE_SKETCH:
+    case RECONCILE_BISECTION_SKETCH:
+      os << ", setSize: " << msg.setSize << ", sketch: " << msg.sketch.size() << " syndromes";
+      break;
+    case RECONCILE_DIFF:
+      os << ", setSize: " << msg.setSize << ", transactions: " << msg.txs.size() << " items";
+      break;
+    case CMPCT_BLOCK:
+    case GET_BLOCK_TXN:
+    case BLOCK_TXN:
+      os << ", block: " << msg.block << ", transactions: " << msg.txs.size() << " items";
+      break;
+    default:
+      break;
+  }
+  return os << "}";
+}
+
+} // Namespace ns3
@@ -0,0 +1,278 @@
+/**
+ * This file declares the decoded form of the messages exchanged between bitcoin nodes,
+ * the BitcoinCodec class, which puts them on the wire, the ReceiveBuffer class, which
+ * collects the byte stream of a connection until whole frames can be decoded, the
+ * BitcoinHeader class, which announces a message in front of a virtual payload, and the
+ * BitcoinMessageStore class, which holds the messages behind these headers.
+ */
+
+#ifndef BITCOIN_MESSAGE_H
+#define BITCOIN_MESSAGE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <ostream>
+#include "ns3/header.h"
+#include "ns3/packet.h"
+#include "bitcoin.h"
+
+namespace ns3 {
+
+const uint32_t BINARY_HEADER_SIZE = 8;
+const uint32_t JSON_PREFIX_SIZE = 4;
+const uint32_t VIRTUAL_FRAME_SIZE = BINARY_HEADER_SIZE + 8;
+
+/**
+ * The header of a real bitcoin message: magic, command, payload length and checksum
+ */
+const uint32_t BITCOIN_HEADER_SIZE = 24;
+
+/**
+ * The decoded form of every message. Fields which are not used by the message type are ignored.
+ */
+typedef struct {
+  enum Messages    type;
+  int              hop;          //!< The hop number of INV and DANDELION_TX messages
+  int              mode;         //!< The ModeType of MODE messages
+  int              setSize;      //!< The set size of RECONCILE_TX_REQUEST, RECONCILE_SKETCH and RECONCILE_DIFF messages
+  int              filterBegin;  //!< The start of the hash range of FILTER_REQUEST and UPDATE_FILTER_BEGIN messages
+  int              filterEnd;    //!< The end of the hash range of FILTER_REQUEST and UPDATE_FILTER_END messages
+  int              block;        //!< The block of CMPCT_BLOCK, GET_BLOCK_TXN and BLOCK_TXN messages
+  std::vector<int> txs;          //!< The inventories of INV, the transaction of DANDELION_TX and the transactions of RECONCILE_TX_RESPONSE, RECONCILE_DIFF and block messages
+  std::vector<uint32_t> sketch;  //!< The syndromes of RECONCILE_SKETCH and RECONCILE_BISECTION_SKETCH messages
+} bitcoinMessage;
+
+std::ostream& operator<< (std::ostream &os, const bitcoinMessage &msg);
+
+
+/**
+ * Encodes and decodes bitcoinMessages.
+ *
+ * Every frame carries its length, so that a message is always written with a single Send and
+ * several frames can be coalesced into one packet.
+ *
+ * JSON_WIRE frames keep the original rapidjson documents, behind a uint32 little-endian length
+ * prefix and followed by their null terminator, which the length includes.
+ *
+ * BINARY_WIRE frames are self-delimiting and consist of an 8 Byte header followed by a packed
+ * little-endian payload:
+ *
+ *   header:  uint8 type | uint8 reserved | uint16 hop | uint32 payload length
+ *   INV, DANDELION_TX, RECONCILE_TX_RESPONSE:  uint32 count | count * int32 transaction
+ *   MODE:                        int32 mode
+ *   RECONCILE_TX_REQUEST:        int32 setSize
+ *   FILTER_REQUEST:              int32 filterBegin | int32 filterEnd
+ *   UPDATE_FILTER_BEGIN:         int32 filterBegin
+ *   UPDATE_FILTER_END:           int32 filterEnd
+ *   RECONCILE_SKETCH, RECONCILE_BISECTION_SKETCH:  int32 setSize | uint32 count | count * uint32 syndrome
+ *   RECONCILE_DIFF:              int32 setSize | uint32 count | count * int32 transaction
+ *   CMPCT_BLOCK, GET_BLOCK_TXN, BLOCK_TXN:  int32 block | uint32 count | count * int32 transaction
+ *
+ * VIRTUAL_WIRE frames carry no payload of their own. They are written by BitcoinHeader:
+ *
+ *   header:  uint8 type | uint8 reserved | uint16 hop | uint32 payload length, always 8
+ *   payload: uint32 handle | uint32 padding length
+ *
+ * The handle designates the message in the BitcoinMessageStore of the process, and the frame is
+ * followed on the stream by padding length bytes of virtual payload, which only account for the size
+ * of the real bitcoin message and are never read.
+ */
+class BitcoinCodec
+{
+public:
+  /**
+   * \brief Appends the frame of a message to a buffer
+   * \param msg the message to encode
+   * \param format the wire format
+   * \param out the buffer to append to
+   */
+  static void Encode (const bitcoinMessage &msg, enum WireFormat format, std::string &out);
+
+  /**
+   * \brief Locates the first complete frame of a byte stream
+   * \param data the start of the stream
+   * \param size the number of bytes available
+   * \param format the wire format
+   * \param frameSize set to the number of bytes the frame occupies in the stream
+   * \return false if the stream does not hold a complete frame yet
+   */
+  static bool NextFrame (const char *data, size_t size, enum WireFormat format, size_t &frameSize);
+
+  /**
+   * \brief Decodes a single message. A VIRTUAL_WIRE message is taken out of the BitcoinMessageStore.
+   * \param data the frame, as located by NextFrame
+   * \param size the length of the frame
+   * \param format the wire format
+   * \param msg the message to decode into. Its txs vector is reused.
+   * \return false if the message is corrupted
+   */
+  static bool Decode (const char *data, size_t size, enum WireFormat format, bitcoinMessage &msg);
+
+  /**
+   * \brief Counts the bytes which are still needed to complete the first frame of a VIRTUAL_WIRE stream.
+   * If the frame length is incomplete, only the bytes up to the frame length are counted.
+   * \param data the start of the stream
+   * \param size the number of bytes available
+   * \return the number of missing bytes
+   */
+  static uint32_t BytesMissing (const char *data, size_t size);
+
+  /**
+   * \brief Reads the length of the virtual payload which follows a VIRTUAL_WIRE frame
+   * \param data the frame, as located by NextFrame
+   * \param size the length of the frame
+   * \return the padding length
+   */
+  static uint32_t PaddingSize (const char *data, size_t size);
+
+  /**
+   * \brief Builds the VIRTUAL_WIRE packet of a message, a BitcoinHeader followed by the virtual
+   * payload, which together take the size of the real bitcoin message: its BITCOIN_HEADER_SIZE
+   * header and its payload. The TCP, IP and link headers are added by the stack the packet goes through.
+   * \param msg the message, copied into the BitcoinMessageStore
+   * \param payloadSize the size of the payload of the real bitcoin message
+   * \return the packet
+   */
+  static Ptr<Packet> EncodeVirtual (const bitcoinMessage &msg, uint32_t payloadSize);
+};
+
+
+/**
+ * The receive buffer of a single connection. Packets are copied once to the tail and frames
+ * are decoded in place from the head, so they always stay contiguous. The unread bytes are
+ * moved back to the start of the storage only when the space at the tail runs out, and the
+ * buffer rewinds for free whenever every buffered frame has been consumed.
+ */
+class ReceiveBuffer
+{
+public:
+  ReceiveBuffer (void);
+
+  /**
+   * \brief Makes room for incoming bytes
+   * \param size the number of bytes about to be written
+   * \return where to write them. The pointer is valid until Commit is called.
+   */
+  uint8_t* Reserve (size_t size);
+
+  /**
+   * \brief Appends the bytes written after the last Reserve call
+   * \param size the number of bytes written
+   */
+  void Commit (size_t size);
+
+  /**
+   * \brief Drops bytes from the head of the buffer. The dropped bytes stay readable until the next Reserve call.
+   * \param size the number of bytes to drop
+   */
+  void Consume (size_t size);
+
+  /**
+   * \brief Announces the virtual payload which follows the last decoded frame
+   * \param size the padding length
+   */
+  void ExpectPadding (uint32_t size);
+
+  /**
+   * \brief Accounts for padding bytes which were skipped without being buffered
+   * \param size the number of skipped bytes
+   */
+  void DropPadding (uint32_t size);
+
+  char* Data (void) { return m_storage.data() + m_head; }
+  size_t Size (void) const { return m_tail - m_head; }
+  uint32_t Padding (void) const { return m_padding; }
+
+private:
+  std::vector<char> m_storage;
+  size_t            m_head;           //!< The first unread byte
+  size_t            m_tail;           //!< One past the last buffered byte
+  uint32_t          m_padding;        //!< The padding bytes still to be skipped
+};
+
+
+/**
+ * Holds the messages sent in the VIRTUAL_WIRE format from their sending to their decoding, so
+ * that only a handle to each of them goes on the wire. The handles are the indices of reusable
+ * slots, whose vectors keep their capacity, so storing a message does not allocate once the
+ * store has grown to the number of messages in flight.
+ *
+ * The store lives in the memory of the process, so VIRTUAL_WIRE only works within a single MPI rank.
+ */
+class BitcoinMessageStore
+{
+public:
+  /**
+   * \return the store of this process
+   */
+  static BitcoinMessageStore &Get (void);
+
+  /**
+   * \brief Copies a message into the store
+   * \return the handle of the message
+   */
+  uint32_t Put (const bitcoinMessage &msg);
+
+  /**
+   * \brief Moves a message out of the store and frees its handle
+   * \param handle the handle returned by Put
+   * \param msg the message to move into. Its vectors are exchanged with the ones of the slot.
+   * \return false if the handle does not designate a stored message
+   */
+  bool Take (uint32_t handle, bitcoinMessage &msg);
+
+  /**
+   * \return the number of messages in the store
+   */
+  size_t Size (void) const { return m_slots.size() - m_free.size(); }
+
+private:
+  BitcoinMessageStore (void) {}
+
+  std::vector<bitcoinMessage> m_slots;
+  std::vector<bool>           m_used;           //!< By handle
+  std::vector<uint32_t>       m_free;           //!< The handles of the free slots
+};
+
+
+/**
+ * Announces a message, in the VIRTUAL_WIRE layout, in front of a virtual payload.
+ * The payload is created as a zero-filled Packet of the padding length, which ns-3
+ * stores without allocating it, so that the links only see the size of the real bitcoin
+ * message while the simulator just serializes the fixed-size header.
+ */
+class BitcoinHeader : public Header
+{
+public:
+  BitcoinHeader (void);
+
+  /**
+   * \param type the type of the message
+   * \param hop the hop number of INV and DANDELION_TX messages
+   * \param handle the handle of the message in the BitcoinMessageStore
+   * \param padding the length of the virtual payload
+   */
+  BitcoinHeader (enum Messages type, int hop, uint32_t handle, uint32_t padding);
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+
+  enum Messages GetType (void) const { return m_type; }
+  uint32_t GetHandle (void) const { return m_handle; }
+  uint32_t GetPadding (void) const { return m_padding; }
+
+private:
+  enum Messages  m_type;
+  int            m_hop;
+  uint32_t       m_handle;       //!< The message in the BitcoinMessageStore
+  uint32_t       m_padding;      //!< The length of the virtual payload
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_MESSAGE_H */
@@ -19,8 +19,12 @@
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
 #include "bitcoin-node.h"
+#include "bitcoin-trace.h"
+#include "bitcoin-sketch.h"
+#include "bitcoin-tx-registry.h"
 #include "../helper/bitcoin-node-helper.h"
-#include <random>
+#include <set>
+#include <iterator>
 #include <math.h>
 
 namespace ns3 {
@@ -29,9 +33,10 @@ NS_LOG_COMPONENT_DEFINE ("BitcoinNode");
 
 NS_OBJECT_ENSURE_REGISTERED (BitcoinNode);
 
-int timeNotToCount = 20;
 
 int RECON_HOP = 999;
+// The hop number recorded for the transactions received with a block
+int BLOCK_HOP = 998;
 
 
 int EstimateDifference(int setSize1, int setSize2, double multiplier) {
@@ -39,12 +44,7 @@ int EstimateDifference(int setSize1, int setSize2, double multiplier) {
 }
 
 int BitcoinNode::PoissonNextSend(int averageIntervalSeconds) {
-    const uint64_t range_from  = 0;
-    const uint64_t range_to    = 1ULL << 48;
-    std::random_device                  rand_dev;
-    std::mt19937                        generator(rand_dev() + GetNode()->GetId());
-    std::uniform_int_distribution<uint64_t>  distr(range_from, range_to);
-    auto bigRand = distr(generator);
+    auto bigRand = m_rng.Next() >> 16;
     return (int)(log1p(bigRand * -0.0000000000000035527136788 /* -1/2^48 */) * averageIntervalSeconds * -1 + 0.5);
 }
 
@@ -89,8 +89,8 @@ BitcoinNode::GetTypeId (void)
 }
 
 BitcoinNode::BitcoinNode (void) : m_bitcoinPort (8333), m_secondsPerMin(60), m_countBytes (4), m_bitcoinMessageHeader (90),
-                                  m_inventorySizeBytes (36), m_getHeadersSizeBytes (72), m_headersSizeBytes (81),
-                                  m_averageTransactionSize (522.4), m_timeToRun(0), m_mode(REGULAR)
+                                  m_inventorySizeBytes (36), m_headersSizeBytes (81),
+                                  m_segmentSize (536), m_timeToRun(0), m_mode(REGULAR)
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
@@ -100,6 +100,7 @@ BitcoinNode::BitcoinNode (void) : m_bitcoinPort (8333), m_secondsPerMin(60), m_c
   m_numInvsSent = 0;
   txCreator = false;
   voidReconciliations = 0;
+  m_isMiner = false;
 }
 
 BitcoinNode::~BitcoinNode(void)
@@ -131,6 +132,13 @@ BitcoinNode::SetPeersAddresses (const std::vector<Ipv4Address> &peers)
   m_numberOfPeers = m_peersAddresses.size();
 }
 
+uint32_t
+BitcoinNode::GetPeerSlot (Ipv4Address peer) const
+{
+  auto it = m_peerSlots.find(peer.Get());
+  return it != m_peerSlots.end() ? it->second : m_peersAddresses.size();
+}
+
 
 void
 BitcoinNode::SetPeersDownloadSpeeds (const std::map<Ipv4Address, double> &peersDownloadSpeeds)
@@ -164,6 +172,27 @@ BitcoinNode::SetNodeStats (nodeStatistics *nodeStats)
   m_nodeStats = nodeStats;
 };
 
+void
+BitcoinNode::SetChannel (Ptr<BitcoinChannel> channel)
+{
+  NS_LOG_FUNCTION (this);
+  m_channel = channel;
+}
+
+void
+BitcoinNode::SetTxGenerator (Ptr<BitcoinTxGenerator> txGenerator)
+{
+  NS_LOG_FUNCTION (this);
+  m_txGenerator = txGenerator;
+}
+
+void
+BitcoinNode::SetBlockGenerator (Ptr<BitcoinBlockGenerator> blockGenerator)
+{
+  NS_LOG_FUNCTION (this);
+  m_blockGenerator = blockGenerator;
+}
+
 void
 BitcoinNode::SetProperties (uint64_t timeToRun, enum ModeType mode,
     int systemId, std::vector<Ipv4Address> outPeers, ProtocolSettings protocolSettings)
@@ -178,24 +207,14 @@ BitcoinNode::SetProperties (uint64_t timeToRun, enum ModeType mode,
 
   m_prevA = A_ESTIMATOR;
 
-  for (auto peer: m_peersAddresses) {
-    if (std::find(m_outPeers.begin(), m_outPeers.end(), peer) == m_outPeers.end())
-      m_inPeers.push_back(peer);
-    m_prevA_per_peer[peer] = A_ESTIMATOR;
-  }
+  /**
+   * Number the peers and lay out their state
+   */
+  size_t peers = m_peersAddresses.size();
+  m_peerSlots.clear();
+  for (uint32_t slot = 0; slot < peers; slot++)
+    m_peerSlots[m_peersAddresses[slot].Get()] = slot;
 
-  if (m_protocolSettings.reconciliationMode != RECON_OFF)
-  {
-      for (auto peer: m_peersAddresses)
-      {
-          std::vector<int> s;
-          m_peerReconciliationSets.insert(std::pair<Ipv4Address,std::vector<int>>(peer, s));
-          if (std::find(m_outPeers.begin(), m_outPeers.end(), peer) != m_outPeers.end()) {
-            m_reconcilePeers.push_back(peer);
-            // m_reconciliationHistory[peer] = std::vector<int>(4, 0);
-          }
-      }
-  }
   peerStatistics peerstats;
   peerstats.numUsefulInvReceived = 0;
   peerstats.numUselessInvReceived = 0;
@@ -203,8 +222,49 @@ BitcoinNode::SetProperties (uint64_t timeToRun, enum ModeType mode,
   peerstats.numGetDataSent = 0;
   peerstats.connectionLength = 0;
   peerstats.usefulInvRate = 0;
-  for(auto peer : m_peersAddresses) {
-    m_peerStatistics.insert(std::pair<Ipv4Address, peerStatistics>(peer, peerstats));
+  peerstats.numInvSent = 0;
+  peerstats.numInvReceived = 0;
+  peerstats.numReconcilUnanswered = 0;
+  peerstats.flaggedAt = -1;
+
+  m_peerSockets.assign(peers, 0);
+  m_peerStatistics.assign(peers, peerstats);
+  m_reconciliationSets.SetPeers(peers);
+  m_prevA_per_peer.assign(peers, A_ESTIMATOR);
+  m_peerSetSizes.assign(peers, -1);
+  peersMode.assign(peers, REGULAR);
+  m_bhSuspects.assign(peers, 0);
+  filterBegin.assign(peers, 0);
+  filterEnd.assign(peers, FILTER_BASE_NUMBERING);
+  requestedFilterBegin.assign(peers, 0);
+  requestedFilterEnd.assign(peers, FILTER_BASE_NUMBERING);
+  m_overlap = m_protocolSettings.filterOverlap;
+  m_peerIsOutbound.assign(peers, false);
+  m_invQueues.assign(peers, std::vector<invItem>());
+  m_invTrickleTimers.assign(peers, EventId());
+  m_pendingInvs.assign(peers, std::unordered_map<int, EventId>());
+  m_reconcileTimers.assign(peers, EventId());
+  m_reconcileInFlight.assign(peers, 0);
+  m_stemDestinations.assign(peers + 1, peers);
+  peersKnowTx.SetPeers(peers);
+
+  for (auto peer: m_outPeers) {
+    uint32_t slot = GetPeerSlot(peer);
+    if (slot < peers)
+      m_peerIsOutbound[slot] = true;
+  }
+
+  m_outSlots.clear();
+  for (uint32_t slot = 0; slot < peers; slot++) {
+    if (m_peerIsOutbound[slot])
+      m_outSlots.push_back(slot);
+  }
+
+  for (uint32_t slot = 0; slot < peers; slot++) {
+    if (!m_peerIsOutbound[slot])
+      m_inPeers.push_back(m_peersAddresses[slot]);
+    else if (m_protocolSettings.reconciliationMode != RECON_OFF)
+      m_reconcilePeers.push_back(m_peersAddresses[slot]);
   }
 }
 
@@ -213,6 +273,9 @@ BitcoinNode::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
+  m_channel = 0;
+  m_txGenerator = 0;
+  m_blockGenerator = 0;
 
   // chain up
   Application::DoDispose ();
@@ -226,7 +289,7 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
   NS_LOG_FUNCTION (this);
   // Create the socket if not already
 
-  srand(time(NULL) + GetNode()->GetId());
+  m_rng.SetStream(GetNode()->GetId());
   NS_LOG_INFO ("Node " << GetNode()->GetId() << ": download speed = " << m_downloadSpeed << " B/s");
   NS_LOG_INFO ("Node " << GetNode()->GetId() << ": upload speed = " << m_uploadSpeed << " B/s");
   NS_LOG_INFO ("Node " << GetNode()->GetId() << ": m_numberOfPeers = " << m_numberOfPeers);
@@ -239,42 +302,59 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
 
   double currentMax = 0;
 
-  if (!m_socket)
+  if (m_channel)
+  {
+    // The channel delivers the messages straight to HandleMessage. Black holes stay detached,
+    // so the channel drops what is sent to them, as HandleRead does.
+    if (m_mode != BLACK_HOLE)
+      m_channel->Attach (GetNode ()->GetId (), this);
+  }
+  else
   {
-    m_socket = Socket::CreateSocket (GetNode (), m_tid);
-    m_socket->Bind (m_local);
-    m_socket->Listen ();
-    m_socket->ShutdownSend ();
-    if (addressUtils::IsMulticast (m_local))
+    if (!m_socket)
     {
-      Ptr<UdpSocket> udpSocket = DynamicCast<UdpSocket> (m_socket);
-      if (udpSocket)
+      m_socket = Socket::CreateSocket (GetNode (), m_tid);
+      m_socket->Bind (m_local);
+      m_socket->Listen ();
+      m_socket->ShutdownSend ();
+      if (addressUtils::IsMulticast (m_local))
       {
-        // equivalent to setsockopt (MCAST_JOIN_GROUP)
-        udpSocket->MulticastJoinGroup (0, m_local);
-      }
-      else
-      {
-        NS_FATAL_ERROR ("Error: joining multicast on a non-UDP socket");
+        Ptr<UdpSocket> udpSocket = DynamicCast<UdpSocket> (m_socket);
+        if (udpSocket)
+        {
+          // equivalent to setsockopt (MCAST_JOIN_GROUP)
+          udpSocket->MulticastJoinGroup (0, m_local);
+        }
+        else
+        {
+          NS_FATAL_ERROR ("Error: joining multicast on a non-UDP socket");
+        }
       }
     }
-  }
 
-  m_socket->SetRecvCallback (MakeCallback (&BitcoinNode::HandleRead, this));
-  m_socket->SetAcceptCallback (
-    MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
-    MakeCallback (&BitcoinNode::HandleAccept, this));
-  m_socket->SetCloseCallbacks (
-    MakeCallback (&BitcoinNode::HandlePeerClose, this),
-    MakeCallback (&BitcoinNode::HandlePeerError, this));
+    m_socket->SetRecvCallback (MakeCallback (&BitcoinNode::HandleRead, this));
+    m_socket->SetAcceptCallback (
+      MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+      MakeCallback (&BitcoinNode::HandleAccept, this));
+    m_socket->SetCloseCallbacks (
+      MakeCallback (&BitcoinNode::HandlePeerClose, this),
+      MakeCallback (&BitcoinNode::HandlePeerError, this));
 
-  NS_LOG_DEBUG ("Node " << GetNode()->GetId() << ": Before creating sockets");
-  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
-  {
-    m_peersSockets[*i] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
-    m_peersSockets[*i]->Connect (InetSocketAddress (*i, m_bitcoinPort));
+    NS_LOG_DEBUG ("Node " << GetNode()->GetId() << ": Before creating sockets");
+    for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++)
+    {
+      m_peerSockets[slot] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
+      m_peerSockets[slot]->Connect (InetSocketAddress (m_peersAddresses[slot], m_bitcoinPort));
+    }
+
+    if (!m_peerSockets.empty())
+    {
+      UintegerValue segmentSize;
+      m_peerSockets[0]->GetAttribute ("SegmentSize", segmentSize);
+      m_segmentSize = segmentSize.Get ();
+    }
+    NS_LOG_DEBUG ("Node " << GetNode()->GetId() << ": After creating sockets");
   }
-  NS_LOG_DEBUG ("Node " << GetNode()->GetId() << ": After creating sockets");
 
   m_nodeStats->nodeId = GetNode()->GetId();
   m_nodeStats->systemId = GetNode()->GetId();
@@ -296,6 +376,37 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
   m_nodeStats->mode = m_mode;
   m_nodeStats->onTheFlyCollisions = 0;
 
+  m_nodeStats->rxReadCalls = 0;
+  m_nodeStats->rxBytesReceived = 0;
+  m_nodeStats->rxBytesBuffered = 0;
+  m_nodeStats->rxFramesDecoded = 0;
+
+  for (int i = 0; i < MESSAGE_TYPES; i++)
+  {
+    m_nodeStats->txPackets[i] = 0;
+    m_nodeStats->txBytes[i] = 0;
+    m_nodeStats->txSegments[i] = 0;
+  }
+  m_nodeStats->knownTxBytes = 0;
+  m_nodeStats->peersKnowTxBytes = 0;
+  m_nodeStats->invEventsExecuted = 0;
+  m_nodeStats->invEventsCancelled = 0;
+  m_nodeStats->dandelionStemRelays = 0;
+  m_nodeStats->dandelionEmbargoFluffs = 0;
+  m_nodeStats->filteredInvs = 0;
+  m_nodeStats->ignoredFilters = 0;
+  m_nodeStats->bhLinks = 0;
+  m_nodeStats->bhDetected = 0;
+  m_nodeStats->bhFalsePositives = 0;
+  m_nodeStats->bhDetectionLatency = 0;
+  m_startedAt = Simulator::Now();
+  m_nodeStats->blocksMined = 0;
+  m_nodeStats->blocksReceived = 0;
+  m_nodeStats->blockRoundTrips = 0;
+  m_nodeStats->blockTxsMissing = 0;
+  m_nodeStats->blockLatencySum = 0;
+  m_nodeStats->blockLatencyMax = 0;
+
   if (m_nodeStats->nodeId == 1) {
     LogTime();
   }
@@ -305,13 +416,40 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
   if (m_mode == BLACK_HOLE)
     return;
 
+  m_isMiner = m_blockGenerator && m_blockGenerator->IsMiner(GetNode()->GetId());
+  if (m_isMiner)
+    m_blockGenerator->Attach(GetNode()->GetId(), this);
+
   if (m_protocolSettings.protocol == DANDELION_MAPPING) {
     RotateDandelionDestinations();
   }
 
-  if (m_protocolSettings.reconciliationMode != RECON_OFF) {
+  if (m_protocolSettings.protocol == FILTERS_ON_INCOMING_LINKS || m_protocolSettings.protocol == OUTGOING_FILTERS) {
+    ValidateNodeFilters();
+  }
+
+  if (m_protocolSettings.bhInference) {
+    Simulator::Schedule (Seconds(BH_CHECK_SECONDS), &BitcoinNode::DetectBlackHoles, this);
+  }
+
+  if (m_protocolSettings.protocol == PREFERRED_OUT_DESTINATIONS || m_protocolSettings.protocol == PREFERRED_ALL_DESTINATIONS) {
+    m_outRanking.SetPeers(m_peersAddresses.size());
+    m_inRanking.SetPeers(m_peersAddresses.size());
+    for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++) {
+      PeerRanking &ranking = m_peerIsOutbound[slot] ? m_outRanking : m_inRanking;
+      ranking.Insert(slot, m_peerStatistics[slot].usefulInvRate, uint32_t(m_rng.Next()));
+    }
+  }
+
+  if (m_protocolSettings.reconciliationMode == TIME_BASED) {
     int nextReconciliation = 10;
     Simulator::Schedule (Seconds(nextReconciliation), &BitcoinNode::ReconcileWithPeer, this);
+  } else if (m_protocolSettings.reconciliationMode == SET_SIZE_BASED) {
+    for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++) {
+      if (m_peerIsOutbound[slot])
+        m_reconcileTimers[slot] = Simulator::Schedule (Seconds(m_protocolSettings.reconciliationMaxDelaySeconds),
+                                                       &BitcoinNode::ReconcileBySetSize, this, slot);
+    }
   }
 }
 
@@ -325,29 +463,134 @@ void BitcoinNode::LogTime() {
 }
 
 void BitcoinNode::RotateDandelionDestinations() {
-  // for (auto peer: m_peersAddresses){
-  //   m_dandelionDestinations[peer].clear();
-  //   std::vector<Ipv4Address> outPeersCopy(m_outPeers);
-  //   for (int i = 0; i < m_protocolSettings.lowfanoutOrderOut; i++) {
-  //     auto peer = ChooseFromPeers(outPeersCopy);
-  //     m_dandelionDestinations[peer].push_back(peer);
-  //     outPeersCopy.erase(std::find(outPeersCopy.begin(), outPeersCopy.end(), peer));
-  //   }
-  //
-  //   std::vector<Ipv4Address> inPeersCopy(m_inPeers);
-  //   for (int i = 0; i < m_protocolSettings.lowfanoutOrderInPercent * m_inPeers.size(); i++) {
-  //     auto peer = ChooseFromPeers(inPeersCopy);
-  //     m_dandelionDestinations[peer].push_back(peer);
-  //     inPeersCopy.erase(std::find(inPeersCopy.begin(), inPeersCopy.end(), peer));
-  //   }
-  // }
-  //
-  // if (m_timeToRun < Simulator::Now().GetSeconds()) {
-  //   return;
-  // }
+  uint32_t k = m_peersAddresses.size();
+  uint32_t stems = std::min<size_t>(DANDELION_STEM_PEERS, m_outSlots.size());
+
+  // Move the stem peers of the epoch to the front of the outbound slots
+  for (uint32_t i = 0; i < stems; i++)
+    std::swap(m_outSlots[i], m_outSlots[i + m_rng.UniformInt(m_outSlots.size() - i)]);
+
+  for (uint32_t slot = 0; slot <= k; slot++)
+    m_stemDestinations[slot] = stems ? m_outSlots[m_rng.UniformInt(stems)] : k;
+
+  if (m_timeToRun < Simulator::Now().GetSeconds()) {
+    return;
+  }
   Simulator::Schedule (Seconds(DANDELION_ROTATION_SECONDS), &BitcoinNode::RotateDandelionDestinations, this);
 }
 
+void
+BitcoinNode::ValidateNodeFilters(void)
+{
+  m_slotBuffer.clear();
+  for (uint32_t slot: m_outSlots) {
+    if (!IsBlackHole(slot))
+      m_slotBuffer.push_back(slot);
+  }
+  if (m_slotBuffer.empty())
+    return;
+
+  // Consecutive ranges tile the hash space, so every transaction is covered by at least one link
+  uint32_t links = m_slotBuffer.size();
+  uint32_t width = std::min<uint32_t>(FILTER_BASE_NUMBERING, ceil(FILTER_BASE_NUMBERING * (1 + m_overlap) / links));
+  for (uint32_t i = 0; i < links; i++) {
+    uint32_t slot = m_slotBuffer[i];
+    uint32_t begin = i * FILTER_BASE_NUMBERING / links;
+    uint32_t end = std::max(begin + width, (i + 1) * FILTER_BASE_NUMBERING / links);
+
+    if (m_protocolSettings.protocol == OUTGOING_FILTERS) {
+      filterBegin[slot] = begin;
+      filterEnd[slot] = end;
+      continue;
+    }
+
+    bitcoinMessage filterData;
+    filterData.filterBegin = begin;
+    filterData.filterEnd = end;
+    // Both bounds go in one message: the peer would see an empty or reversed filter between
+    // separate UPDATE_FILTER_BEGIN and UPDATE_FILTER_END messages
+    if (requestedFilterEnd[slot] - requestedFilterBegin[slot] == FILTER_BASE_NUMBERING ||
+        begin != requestedFilterBegin[slot] || end != requestedFilterEnd[slot]) {
+      filterData.type = FILTER_REQUEST;
+      SendMessage(filterData, m_peersAddresses[slot]);
+    }
+    requestedFilterBegin[slot] = begin;
+    requestedFilterEnd[slot] = end;
+  }
+}
+
+void
+BitcoinNode::UpdateFilterBegin(Ipv4Address& peer, uint32_t newVal)
+{
+  uint32_t slot = GetPeerSlot(peer);
+  if (slot == m_peersAddresses.size() || !FilterIsValid(newVal, filterEnd[slot]))
+    return;
+  filterBegin[slot] = newVal;
+}
+
+void
+BitcoinNode::UpdateFilterEnd(Ipv4Address& peer, uint32_t newVal)
+{
+  uint32_t slot = GetPeerSlot(peer);
+  if (slot == m_peersAddresses.size() || !FilterIsValid(filterBegin[slot], newVal))
+    return;
+  filterEnd[slot] = newVal;
+}
+
+void
+BitcoinNode::RelayStemTransaction(int txId, uint32_t fromSlot, int hopNumber)
+{
+  uint32_t k = m_peersAddresses.size();
+  uint32_t destination = m_stemDestinations[fromSlot];
+
+  // Never send a stem back where it came from
+  if (destination == fromSlot)
+    destination = (m_outSlots.size() > 1 && DANDELION_STEM_PEERS > 1) ?
+                  (m_outSlots[0] == fromSlot ? m_outSlots[1] : m_outSlots[0]) : k;
+
+  // Our own transactions always start with a stem hop
+  if (destination == k || (fromSlot != k && m_rng.UniformReal() < m_protocolSettings.dandelionFluffProbability)) {
+    FluffTransaction(txId, fromSlot, hopNumber);
+    return;
+  }
+
+  bitcoinMessage stem;
+  stem.type = DANDELION_TX;
+  stem.hop = hopNumber;
+  stem.txs.push_back(txId);
+  SendMessage(stem, m_peersAddresses[destination]);
+  peersKnowTx.Add(txId, destination);
+  m_nodeStats->dandelionStemRelays++;
+
+  double embargo = -log(1 - m_rng.UniformReal()) * m_protocolSettings.dandelionEmbargoSeconds;
+  m_embargoes[txId] = Simulator::Schedule (Seconds(embargo), &BitcoinNode::EmbargoExpired, this, txId, hopNumber);
+}
+
+void
+BitcoinNode::FluffTransaction(int txId, uint32_t fromSlot, int hopNumber)
+{
+  auto it = m_embargoes.find(txId);
+  if (it != m_embargoes.end()) {
+    Simulator::Cancel(it->second);
+    m_embargoes.erase(it);
+  }
+
+  Ipv4Address from = fromSlot < m_peersAddresses.size() ? m_peersAddresses[fromSlot] : InetSocketAddress::ConvertFrom(m_local).GetIpv4();
+  if (m_isMiner && !m_confirmedTxs.Contains(txId))
+    m_mempool.push_back(txId);
+  AdvertiseNewTransactionInvStandard(from, txId, hopNumber);
+  if (m_protocolSettings.reconciliationMode != RECON_OFF)
+    AddToReconciliationSets(txId, from);
+}
+
+void
+BitcoinNode::EmbargoExpired(int txId, int hopNumber)
+{
+  m_embargoes.erase(txId);
+  m_nodeStats->dandelionEmbargoFluffs++;
+  FluffTransaction(txId, m_peersAddresses.size(), hopNumber);
+}
+
 
 
 void
@@ -355,9 +598,36 @@ BitcoinNode::StopApplication ()     // Called at time specified by Stop
 {
   NS_LOG_FUNCTION (this);
 
-  for (std::vector<Ipv4Address>::iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i) //close the outgoing sockets
+  if (m_channel)
+    m_channel->Detach (GetNode ()->GetId ());
+  if (m_txGenerator)
+    m_txGenerator->Detach (GetNode ()->GetId ());
+  if (m_blockGenerator)
+    m_blockGenerator->Detach (GetNode ()->GetId ());
+
+  m_nodeStats->knownTxBytes = knownTxHashes.GetMemoryUsage ();
+  m_nodeStats->peersKnowTxBytes = peersKnowTx.GetMemoryUsage ();
+
+  for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++)
   {
-    m_peersSockets[*i]->Close ();
+    double flaggedAt = m_peerStatistics[slot].flaggedAt;
+    if (peersMode[slot] != BLACK_HOLE)
+    {
+      m_nodeStats->bhFalsePositives += flaggedAt >= 0;
+      continue;
+    }
+    m_nodeStats->bhLinks++;
+    if (flaggedAt >= 0)
+    {
+      m_nodeStats->bhDetected++;
+      m_nodeStats->bhDetectionLatency += flaggedAt - m_startedAt.GetSeconds();
+    }
+  }
+
+  for (auto socket: m_peerSockets) //close the outgoing sockets
+  {
+    if (socket)
+      socket->Close ();
   }
 
 
@@ -374,51 +644,18 @@ void
 BitcoinNode::ReconcileWithPeer(void) {
     assert(m_reconcilePeers.size() != 0);
 
-    const uint8_t delimiter[] = "#";
+    // The skipped black holes stay in the queue, since a peer may announce another mode
     Ipv4Address peer;
-    if (m_protocolSettings.reconciliationMode == TIME_BASED) {
+    bool skipped;
+    size_t left = m_reconcilePeers.size();
+    do {
       peer = m_reconcilePeers.front();
-      if (m_protocolSettings.bhDetection && peersMode[peer] == BLACK_HOLE) {
-        m_reconcilePeers.pop_front();
-        peer = m_reconcilePeers.front();
-      }
       m_reconcilePeers.pop_front();
       m_reconcilePeers.push_back(peer);
-    } else if (m_protocolSettings.reconciliationMode = SET_SIZE_BASED) {
-      bool peerFound = false;
-      for (auto curPeer: m_reconcilePeers) {
-        size_t setSize = m_peerReconciliationSets[peer].size();
-        if (setSize > RECON_MAX_SET_SIZE) {
-          peer = curPeer;
-          peerFound = true;
-          break;
-        }
-      }
-      if (!peerFound) {
-          Simulator::Schedule (Seconds(m_protocolSettings.reconciliationIntervalSeconds), &BitcoinNode::ReconcileWithPeer, this);
-          return;
-      }
-    }
-    size_t set_size = m_peerReconciliationSets[peer].size();
-
-    rapidjson::Document reconcileData;
-    rapidjson::Value value;
-    value = RECONCILE_TX_REQUEST;
-    reconcileData.SetObject();
-    reconcileData.AddMember("message", value, reconcileData.GetAllocator());
-
-    rapidjson::Value setSize;
-
-    setSize.SetInt(set_size);
-
-    reconcileData.AddMember("setSize", setSize, reconcileData.GetAllocator());
-
-    rapidjson::StringBuffer reconcileInfo;
-    rapidjson::Writer<rapidjson::StringBuffer> reconcileWriter(reconcileInfo);
-    reconcileData.Accept(reconcileWriter);
-
-    m_peersSockets[peer]->Send(reinterpret_cast<const uint8_t*>(reconcileInfo.GetString()), reconcileInfo.GetSize(), 0);
-    m_peersSockets[peer]->Send(delimiter, 1, 0);
+      skipped = SkipsReconciliation(GetPeerSlot(peer));
+    } while (skipped && --left > 0);
+    if (!skipped)
+      StartReconciliation(peer);
 
     if (m_timeToRun < Simulator::Now().GetSeconds()) {
       return;
@@ -426,51 +663,128 @@ BitcoinNode::ReconcileWithPeer(void) {
     Simulator::Schedule (Seconds(m_protocolSettings.reconciliationIntervalSeconds), &BitcoinNode::ReconcileWithPeer, this);
 }
 
-Ipv4Address
-BitcoinNode::ChooseFromPeers(std::vector<Ipv4Address> peers)
+void
+BitcoinNode::StartReconciliation(Ipv4Address peer)
 {
-    if (m_peerStatistics.empty())
-        NS_FATAL_ERROR ("Error: m_peerStatistics is empty");
-    std::random_device rd;
-    std::mt19937 eng(rd());
-    std::uniform_int_distribution<> distr(0, peers.size() - 1);
-    int index = distr(eng);
-    return peers.at(index);
+    if (m_protocolSettings.sketchReconciliation) {
+      SendReconciliationSketch(peer);
+    } else {
+      bitcoinMessage reconcileData;
+      reconcileData.type = RECONCILE_TX_REQUEST;
+      reconcileData.setSize = m_reconciliationSets.Size(GetPeerSlot(peer));
+      SendMessage(reconcileData, peer);
+      m_peerStatistics[GetPeerSlot(peer)].numReconcilUnanswered++;
+    }
 }
 
 void
-BitcoinNode::AnnounceMode (void)
+BitcoinNode::CheckReconciliationThreshold(uint32_t slot)
 {
-  int count = 0;
-  const uint8_t delimiter[] = "#";
+    if (m_protocolSettings.reconciliationMode != SET_SIZE_BASED || !m_peerIsOutbound[slot] || m_reconcileInFlight[slot])
+      return;
+    if (int(m_reconciliationSets.Size(slot)) >= m_protocolSettings.reconciliationThreshold)
+      ReconcileBySetSize(slot);
+}
 
-  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
-  {
-    rapidjson::Document modeData;
+void
+BitcoinNode::ReconcileBySetSize(uint32_t slot)
+{
+    EventId &timer = m_reconcileTimers[slot];
+    timer.Cancel();
+    if (m_timeToRun >= Simulator::Now().GetSeconds())
+      timer = Simulator::Schedule (Seconds(m_protocolSettings.reconciliationMaxDelaySeconds),
+                                   &BitcoinNode::ReconcileBySetSize, this, slot);
 
-    rapidjson::Value value;
-    value = MODE;
-    modeData.SetObject();
+    if (SkipsReconciliation(slot))
+      return;
+    m_reconcileInFlight[slot] = 1;
+    StartReconciliation(m_peersAddresses[slot]);
+}
 
-    modeData.AddMember("message", value, modeData.GetAllocator());
+void
+BitcoinNode::UpdatePeerScore(uint32_t slot, bool useful)
+{
+    peerStatistics &stats = m_peerStatistics[slot];
+    if (useful)
+      stats.numUsefulInvReceived++;
+    else
+      stats.numUselessInvReceived++;
+    // A peer we did not hear from yet ranks below any peer which sent a useful INV
+    stats.usefulInvRate = stats.numUsefulInvReceived * 1.0 / (stats.numUsefulInvReceived + stats.numUselessInvReceived + 1);
+
+    if (m_outRanking.Contains(slot))
+      m_outRanking.Update(slot, stats.usefulInvRate);
+    else if (m_inRanking.Contains(slot))
+      m_inRanking.Update(slot, stats.usefulInvRate);
+}
 
-    rapidjson::Value modeValue;
-    modeValue.SetInt(m_mode);
+bool
+BitcoinNode::IsBlackHole(uint32_t slot) const
+{
+    if (m_protocolSettings.bhInference)
+      return m_bhSuspects[slot];
+    return peersMode[slot] == BLACK_HOLE;
+}
 
+bool
+BitcoinNode::SkipsReconciliation(uint32_t slot) const
+{
+    return m_protocolSettings.bhDetection && !m_protocolSettings.bhInference && peersMode[slot] == BLACK_HOLE;
+}
 
-    modeData.AddMember("mode", modeValue, modeData.GetAllocator());
+void
+BitcoinNode::DetectBlackHoles(void)
+{
+    bool changed = false;
+    for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++) {
+      peerStatistics &stats = m_peerStatistics[slot];
+      bool silent = stats.numInvSent >= BH_MIN_INVS_SENT && stats.numInvReceived < BH_MIN_INV_RATIO * stats.numInvSent;
+      bool unresponsive = stats.numReconcilUnanswered >= BH_MISSED_RECONCILIATIONS;
+      uint8_t suspect = silent || unresponsive;
+      if (suspect == m_bhSuspects[slot])
+        continue;
+      m_bhSuspects[slot] = suspect;
+      changed = true;
+      if (!suspect)
+        continue;
+
+      if (stats.flaggedAt < 0)
+        stats.flaggedAt = Simulator::Now().GetSeconds();
+
+      // Nothing we hold for the peer would reach the network
+      for (auto &pending: m_pendingInvs[slot]) {
+        Simulator::Cancel(pending.second);
+        m_nodeStats->invEventsCancelled++;
+      }
+      m_pendingInvs[slot].clear();
+      m_nodeStats->invEventsCancelled += m_invQueues[slot].size();
+      m_invQueues[slot].clear();
+      m_invTrickleTimers[slot].Cancel();
+      std::vector<int> dropped;
+      m_reconciliationSets.Take(slot, dropped);
+    }
+
+    if (changed && (m_protocolSettings.protocol == FILTERS_ON_INCOMING_LINKS || m_protocolSettings.protocol == OUTGOING_FILTERS))
+      ValidateNodeFilters();
 
+    if (m_timeToRun >= Simulator::Now().GetSeconds())
+      Simulator::Schedule (Seconds(BH_CHECK_SECONDS), &BitcoinNode::DetectBlackHoles, this);
+}
 
-    rapidjson::StringBuffer modeInfo;
-    rapidjson::Writer<rapidjson::StringBuffer> modeWriter(modeInfo);
-    modeData.Accept(modeWriter);
+void
+BitcoinNode::AnnounceMode (void)
+{
+  bitcoinMessage modeData;
+  modeData.type = MODE;
+  modeData.mode = m_mode;
 
-    m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(modeInfo.GetString()), modeInfo.GetSize(), 0);
-    m_peersSockets[*i]->Send(delimiter, 1, 0);
+  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+  {
+    SendMessage(modeData, *i);
   }
 
-  if (m_mode == TX_EMITTER)
-    Simulator::Schedule (Seconds(5), &BitcoinNode::ScheduleNextTransactionEvent, this);
+  if (m_mode == TX_EMITTER && m_txGenerator)
+    m_txGenerator->Attach (GetNode ()->GetId (), this);
 
 }
 
@@ -484,42 +798,131 @@ int MurmurHash3Mixer(int key) // TODO a better hash function
   return key;
 }
 
-void
-BitcoinNode::ScheduleNextTransactionEvent (void)
+uint32_t
+BitcoinNode::FilterPosition(int txId)
 {
-  NS_LOG_FUNCTION (this);
-
-  // 7 tx/s
-  int currentMinute = Simulator::Now().GetSeconds() / 60;
-  int revProbability = TX_EMITTERS/transactionRates[currentMinute];
-  bool emit = (rand() % revProbability) == 0;
-
-  // Do not emit transactions which will be never reconciled in the network
-  if (m_timeToRun < Simulator::Now().GetSeconds() + timeNotToCount)
-    return;
-
-  if (emit)
-    EmitTransaction();
-  Simulator::Schedule (Seconds(1), &BitcoinNode::ScheduleNextTransactionEvent, this);
+  return uint32_t(MurmurHash3Mixer(txId)) % FILTER_BASE_NUMBERING;
 }
 
 void
-BitcoinNode::EmitTransaction (void)
+BitcoinNode::EmitTransaction (int transactionId)
 {
   NS_LOG_FUNCTION (this);
   int nodeId = GetNode()->GetId();
   m_nodeStats->txCreated++;
 
-  int transactionId = nodeId*1000000 + m_nodeStats->txCreated;
+  BITCOIN_TRACE_INFO ("Node " << nodeId << " created transaction " << transactionId
+                      << " with id " << BitcoinTxRegistry::Get().GetId(transactionId));
   auto myself = InetSocketAddress::ConvertFrom(m_local).GetIpv4();
 
-  if (m_protocolSettings.protocol == STANDARD_PROTOCOL || m_inPeers.size() > 0) {
+  if (m_protocolSettings.protocol == DANDELION_MAPPING) {
+    SaveTxData(transactionId, myself, 0, false);
+    RelayStemTransaction(transactionId, m_peersAddresses.size(), 0);
+    return;
+  }
+
+  if (m_protocolSettings.protocol == STANDARD_PROTOCOL || m_protocolSettings.protocol == FILTERS_ON_INCOMING_LINKS ||
+      m_protocolSettings.protocol == OUTGOING_FILTERS || m_inPeers.size() > 0) {
     AdvertiseTransactionInvWrapper(myself, transactionId, 0);
     // std::cout << "Have in peers, flooding" << std::endl;
   }
   SaveTxData(transactionId, myself, 0);
 }
 
+void
+BitcoinNode::MineBlock(int block)
+{
+  NS_LOG_FUNCTION (this);
+  m_nodeStats->blocksMined++;
+  m_knownBlocks.Insert(block);
+
+  // Take the oldest transactions no block holds yet, and keep the others in order. A transaction
+  // is confirmed as soon as it is taken, so a second copy of it in the mempool is dropped
+  std::vector<int> txs;
+  size_t kept = 0;
+  for (int txId: m_mempool) {
+    if (m_confirmedTxs.Contains(txId))
+      continue;
+    if (txs.size() < BLOCK_MAX_TXS) {
+      txs.push_back(txId);
+      m_confirmedTxs.Insert(txId);
+    }
+    else
+      m_mempool[kept++] = txId;
+  }
+  m_mempool.resize(kept);
+
+  BITCOIN_TRACE_INFO ("Node " << GetNode()->GetId() << " mined block " << block << " with " << txs.size() << " transactions");
+  ForgetConfirmedTransactions(txs);
+  RelayBlock(block, txs, m_peersAddresses.size());
+}
+
+void
+BitcoinNode::CompleteBlock(int block, const std::vector<int> &txs, uint32_t fromSlot)
+{
+  double latency = Simulator::Now().GetSeconds() - m_blockGenerator->GetMinedTime(block);
+  m_nodeStats->blocksReceived++;
+  m_nodeStats->blockLatencySum += latency;
+  m_nodeStats->blockLatencyMax = std::max(m_nodeStats->blockLatencyMax, latency);
+
+  if (m_isMiner) {
+    for (int txId: txs)
+      m_confirmedTxs.Insert(txId);
+  }
+  ForgetConfirmedTransactions(txs);
+  RelayBlock(block, txs, fromSlot);
+}
+
+void
+BitcoinNode::ForgetConfirmedTransactions(const std::vector<int> &txs)
+{
+  std::vector<int> confirmed(txs);
+  std::sort(confirmed.begin(), confirmed.end());
+
+  for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++) {
+    std::unordered_map<int, EventId> &pending = m_pendingInvs[slot];
+    for (auto it = pending.begin(); it != pending.end(); ) {
+      if (std::binary_search(confirmed.begin(), confirmed.end(), it->first)) {
+        Simulator::Cancel(it->second);
+        it = pending.erase(it);
+        m_nodeStats->invEventsCancelled++;
+      } else {
+        ++it;
+      }
+    }
+
+    std::vector<invItem> &queue = m_invQueues[slot];
+    size_t kept = 0;
+    for (const invItem &item: queue) {
+      if (std::binary_search(confirmed.begin(), confirmed.end(), item.txHash))
+        m_nodeStats->invEventsCancelled++;
+      else
+        queue[kept++] = item;
+    }
+    queue.resize(kept);
+
+    if (m_protocolSettings.reconciliationMode != RECON_OFF) {
+      for (int txId: txs)
+        m_reconciliationSets.Remove(txId, slot);
+    }
+  }
+}
+
+void
+BitcoinNode::RelayBlock(int block, const std::vector<int> &txs, uint32_t fromSlot)
+{
+  // As in the high-bandwidth mode of BIP152, the block goes out before any INV or header
+  bitcoinMessage announcement;
+  announcement.type = CMPCT_BLOCK;
+  announcement.block = block;
+  announcement.txs = txs;
+  for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++) {
+    if (slot == fromSlot || (m_protocolSettings.bhDetection && IsBlackHole(slot)))
+      continue;
+    SendMessage(announcement, m_peersAddresses[slot]);
+  }
+}
+
 
 void
 BitcoinNode::HandleRead (Ptr<Socket> socket)
@@ -527,6 +930,8 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
   NS_LOG_FUNCTION (this << socket);
   Ptr<Packet> packet;
   Address from;
+  ReceiveBuffer &buffer = m_receiveBuffers[PeekPointer (socket)];
+  bool received = false;
 
   while ((packet = socket->RecvFrom (from)))
   {
@@ -535,207 +940,486 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
          break;
       }
 
-      if (m_mode == BLACK_HOLE)
+      // Virtual messages still have to be taken out of the store, HandleMessage drops them
+      if (m_mode == BLACK_HOLE && m_protocolSettings.wireFormat != VIRTUAL_WIRE)
         return;
 
+      m_rxTrace (packet, from);
+
       if (InetSocketAddress::IsMatchingType (from))
       {
         /**
          * We may receive more than one packets simultaneously on the socket,
          * so we have to parse each one of them.
          */
-        std::string delimiter = "#";
-        std::string parsedPacket;
-        size_t pos = 0;
-        char *packetInfo = new char[packet->GetSize () + 1];
-        std::ostringstream totalStream;
+        enum WireFormat format = m_protocolSettings.wireFormat;
+        size_t frameSize;
+        uint32_t packetSize = packet->GetSize ();
 
-        packet->CopyData (reinterpret_cast<uint8_t*>(packetInfo), packet->GetSize ());
-        packetInfo[packet->GetSize ()] = '\0'; // ensure that it is null terminated to avoid bugs
+        received = true;
+        m_nodeStats->rxBytesReceived += packetSize;
 
-        /**
-         * Add the buffered data to complete the packet
-         */
-        totalStream << m_bufferedData[from] << packetInfo;
-        std::string totalReceivedData(totalStream.str());
-        NS_LOG_INFO("Node " << GetNode ()->GetId () << " Total Received Data: " << totalReceivedData);
-
-        while ((pos = totalReceivedData.find(delimiter)) != std::string::npos)
+        while (packet->GetSize () > 0)
         {
-          parsedPacket = totalReceivedData.substr(0, pos);
-          NS_LOG_INFO("Node " << GetNode ()->GetId () << " Parsed Packet: " << parsedPacket);
-
-          rapidjson::Document d;
-          d.Parse(parsedPacket.c_str());
-
-          if(!d.IsObject())
+          uint32_t chunk = packet->GetSize ();
+          if (format == VIRTUAL_WIRE)
           {
-            NS_LOG_WARN("The parsed packet is corrupted");
-            totalReceivedData.erase(0, pos + delimiter.length());
-            continue;
+            /**
+             * Only the message headers are copied out of the packet, the padding behind them is dropped
+             */
+            if (buffer.Padding () > 0)
+            {
+              chunk = std::min (chunk, buffer.Padding ());
+              buffer.DropPadding (chunk);
+              packet->RemoveAtStart (chunk);
+              continue;
+            }
+            chunk = std::min (chunk, BitcoinCodec::BytesMissing (buffer.Data (), buffer.Size ()));
           }
 
-          rapidjson::StringBuffer buffer;
-          rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-          d.Accept(writer);
-
-          Ipv4Address peer = InetSocketAddress::ConvertFrom(from).GetIpv4();
+          /**
+           * Append the packet to the buffered data of the connection
+           */
+          packet->CopyData (buffer.Reserve (chunk), chunk);
+          buffer.Commit (chunk);
+          packet->RemoveAtStart (chunk);
+          BITCOIN_TRACE_DEBUG ("Node " << GetNode ()->GetId () << " Total Received Data: " << buffer.Size () << " bytes");
 
-          NS_LOG_INFO ("At time "  << Simulator::Now ().GetSeconds ()
-                        << "s bitcoin node " << GetNode ()->GetId () << " received "
-                        <<  packet->GetSize () << " bytes from "
-                        << InetSocketAddress::ConvertFrom(from).GetIpv4 ()
-                        << " port " << InetSocketAddress::ConvertFrom (from).GetPort ()
-                        << " with info = " << buffer.GetString());
-
-
-          switch (d["message"].GetInt())
+          while (BitcoinCodec::NextFrame (buffer.Data (), buffer.Size (), format, frameSize))
           {
-            case MODE:
-            {
-              ModeType mode = ModeType(d["mode"].GetInt());
-              peersMode[peer] = mode;
-              break;
-            }
-            case RECONCILE_TX_REQUEST:
-            {
-                size_t set =  d["setSize"].GetInt();
-                auto delay = PoissonNextSend(1) + 2;
-                Simulator::Schedule (Seconds(delay), &BitcoinNode::RespondToReconciliationRequest, this, peer);
-                break;
-            }
-            case RECONCILE_TX_RESPONSE:
-            {
-                std::set<int> nodeBtransactions;
-                int iMissCounter = 0;
-                std::vector<int> peerSet = std::vector<int>(m_peerReconciliationSets[peer]);
-                int mySubSetSize[SUB_SETS] = {0};
-                int hisSubSetSize[SUB_SETS] = {0};
-                for (rapidjson::Value::ConstValueIterator itr = d["transactions"].Begin(); itr != d["transactions"].End(); ++itr) {
-                    int txId = itr->GetInt();
-                    hisSubSetSize[MurmurHash3Mixer(txId) % SUB_SETS]++;
-                    peersKnowTx[txId].push_back(peer);
-                    nodeBtransactions.insert(txId);
-                    if (std::find(peerSet.begin(), peerSet.end(), txId) != peerSet.end()) {
-                      continue;
-                    } else {
-                      if (std::find(knownTxHashes.begin(), knownTxHashes.end(), txId) != knownTxHashes.end()) {
-                        continue;
-                      }
-                    }
-                    iMissCounter++;
-                    SaveTxData(txId, peer, RECON_HOP);
-                    // AdvertiseTransactionInvWrapper(peer, txId, 0);
-                }
-                int heMissCounter = 0;
-                for (int it: peerSet)
-                {
-                    mySubSetSize[MurmurHash3Mixer(it) % SUB_SETS]++;
-                    // m_peerReconciliationSets[peer].clear();
-                    if (std::find(nodeBtransactions.begin(), nodeBtransactions.end(), it) == nodeBtransactions.end())
-                    {
-                        // Do not inv to out peer, it will learn it later ???
-                        // Due to assymetry in the network
-                        // m_peerReconciliationSets[peer].push_back(it);
-                        Simulator::Schedule (Seconds(0.1), &BitcoinNode::SendInvToNode, this, peer, it, RECON_HOP);
-                        heMissCounter++;
-                    }
-                }
-                m_peerReconciliationSets[peer].clear();
-                int totalDiff = iMissCounter + heMissCounter;
-                if (m_timeToRun < Simulator::Now().GetSeconds() + timeNotToCount)
-                  break;
-
-                // int estimatedDiff = (EstimateDifference(peerSet.size(), d["transactions"].Size(), 0.1) * m_protocolSettings.qEstimationMultiplier +
-                //   m_reconciliationHistory[peer] * (1-m_protocolSettings.qEstimationMultiplier));
-
-                // int estimatedDiff = 0;
-                // for (int i = 0; i < SUB_SETS; i++) {
-                //   estimatedDiff += EstimateDifference(mySubSetSize[i], hisSubSetSize[i], 0.1);
-                // }
-
-                int mySetSize = peerSet.size();
-                int hisSetSize = d["transactions"].Size();
-                m_prevA = m_prevA_per_peer[peer];
-                int estimatedDiff = EstimateDifference(mySetSize, hisSetSize, m_prevA) + m_protocolSettings.qEstimationMultiplier;
-                if (mySetSize * hisSetSize != 0 && estimatedDiff >= mySetSize + hisSetSize) {
-                  m_prevA = (totalDiff-std::abs(mySetSize - hisSetSize)) / std::min(mySetSize, hisSetSize);
-                  m_prevA_per_peer[peer] = m_prevA;
-                }
-
-                reconcilItem item;
-                item.setInSize = d["transactions"].Size();
-                item.setOutSize = peerSet.size();
-                item.diffSize = totalDiff;
-                item.estimatedDiff = estimatedDiff;
-                item.nodeId = m_nodeStats->nodeId;
-                m_nodeStats->reconcilData.push_back(item);
-                m_nodeStats->reconcils++;
-                // m_reconciliationHistory[peer] = totalDiff;
-                break;
-            }
-            case INV:
+            // The frame stays readable until more data is appended
+            const char *frame = buffer.Data ();
+            buffer.Consume (frameSize);
+            m_nodeStats->rxFramesDecoded++;
+            if (format == VIRTUAL_WIRE)
+              buffer.ExpectPadding (BitcoinCodec::PaddingSize (frame, frameSize));
+
+            if (!BitcoinCodec::Decode (frame, frameSize, format, m_rxMessage))
             {
-              std::vector<std::string>            requestTxs;
-              for (int j=0; j<d["inv"].Size(); j++)
-              {
-                int   parsedInv = d["inv"][j].GetInt();
-                int   hopNumber = d["hop"].GetInt();
-                if (std::find(peersKnowTx[parsedInv].begin(), peersKnowTx[parsedInv].end(), peer) != peersKnowTx[parsedInv].end())
-                  m_nodeStats->onTheFlyCollisions++;
-                if (hopNumber == RECON_HOP ) {
-                  m_nodeStats->reconInvReceivedMessages++;
-                } else {
-                  m_nodeStats->invReceivedMessages++;
-                }
-                peersKnowTx[parsedInv].push_back(peer);
-                if (m_protocolSettings.reconciliationMode != RECON_OFF) {
-                  RemoveFromReconciliationSets(parsedInv, peer);
-                }
-
-                if (std::find(knownTxHashes.begin(), knownTxHashes.end(), parsedInv) != knownTxHashes.end()) {
-                    // loop handling
-                    if (hopNumber == RECON_HOP ) {
-                      m_nodeStats->reconUselessInvReceivedMessages++;
-                    } else {
-                      m_nodeStats->uselessInvReceivedMessages++;
-                    }
-                    // if (std::find(loopHistory.begin(), loopHistory.end(), parsedInv) == loopHistory.end() &&
-                    //   m_protocolSettings.loopAccommodation == 1) {
-                    //   loopHistory.push_back(parsedInv);
-                    //   AdvertiseTransactionInvWrapper(from, parsedInv, hopNumber + 1);
-                    // }
-                    continue;
-                } else {
-                  SaveTxData(parsedInv, peer, hopNumber);
-                  AdvertiseTransactionInvWrapper(from, parsedInv, hopNumber + 1);
-                }
-              }
-              break;
+              BITCOIN_TRACE_WARN ("The parsed packet is corrupted");
+              continue;
             }
-            default:
-              NS_LOG_INFO ("Default");
-              break;
-          }
 
-          totalReceivedData.erase(0, pos + delimiter.length());
+            HandleMessage (m_rxMessage, from);
+          }
         }
-
-        /**
-        * Buffer the remaining data
-        */
-        m_bufferedData[from] = totalReceivedData;
-        delete[] packetInfo;
       }
       else if (Inet6SocketAddress::IsMatchingType (from))
       {
-        NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
+        BITCOIN_TRACE_INFO ("At time " << Simulator::Now ().GetSeconds ()
                      << "s bitcoin node " << GetNode ()->GetId () << " received "
                      <<  packet->GetSize () << " bytes from "
                      << Inet6SocketAddress::ConvertFrom(from).GetIpv6 ()
                      << " port " << Inet6SocketAddress::ConvertFrom (from).GetPort ());
       }
-      m_rxTrace (packet, from);
+  }
+
+  if (received)
+  {
+    m_nodeStats->rxReadCalls++;
+    m_nodeStats->rxBytesBuffered += buffer.Size ();
+  }
+}
+
+void
+BitcoinNode::HandleMessage (const bitcoinMessage &msg, const Address &from)
+{
+  Ipv4Address peer = InetSocketAddress::ConvertFrom(from).GetIpv4();
+  uint32_t slot = GetPeerSlot(peer);
+
+  BITCOIN_TRACE_INFO ("At time "  << Simulator::Now ().GetSeconds ()
+                << "s bitcoin node " << GetNode ()->GetId () << " received a message from "
+                << InetSocketAddress::ConvertFrom(from).GetIpv4 ()
+                << " port " << InetSocketAddress::ConvertFrom (from).GetPort ()
+                << " with info = " << msg);
+
+  if (slot == m_peersAddresses.size())
+  {
+    BITCOIN_TRACE_WARN ("Node " << GetNode ()->GetId () << " received a message from " << peer << ", which is not a peer");
+    return;
+  }
+
+  // Black holes drop everything, whichever transport delivered it
+  if (m_mode == BLACK_HOLE)
+    return;
+
+  switch (msg.type)
+  {
+    case MODE:
+    {
+      ModeType mode = ModeType(msg.mode);
+      peersMode[slot] = mode;
+      // A black hole relays nothing, so its share of the hash space goes to the other links
+      if (mode == BLACK_HOLE && m_peerIsOutbound[slot] && m_protocolSettings.bhDetection && !m_protocolSettings.bhInference &&
+          (m_protocolSettings.protocol == FILTERS_ON_INCOMING_LINKS || m_protocolSettings.protocol == OUTGOING_FILTERS))
+        ValidateNodeFilters();
+      break;
+    }
+    case FILTER_REQUEST:
+    {
+      if (FilterIsValid(msg.filterBegin, msg.filterEnd)) {
+        filterBegin[slot] = msg.filterBegin;
+        filterEnd[slot] = msg.filterEnd;
+      }
+      break;
+    }
+    case UPDATE_FILTER_BEGIN:
+    {
+      UpdateFilterBegin(peer, msg.filterBegin);
+      break;
+    }
+    case UPDATE_FILTER_END:
+    {
+      UpdateFilterEnd(peer, msg.filterEnd);
+      break;
+    }
+    case RECONCILE_TX_REQUEST:
+    {
+        size_t set = msg.setSize;
+        auto delay = PoissonNextSend(1) + 2;
+        Simulator::Schedule (Seconds(delay), &BitcoinNode::RespondToReconciliationRequest, this, peer);
+        break;
+    }
+    case RECONCILE_TX_RESPONSE:
+    {
+        // The fallback of a sketch reconciliation we respond to
+        if (m_sketchesReceived.find(peer) != m_sketchesReceived.end()) {
+          std::vector<int> mine(m_sketchesReceived[peer].snapshot);
+          std::vector<int> his(msg.txs);
+          std::vector<int> iMiss, heMisses;
+          std::sort(mine.begin(), mine.end());
+          std::sort(his.begin(), his.end());
+          ReconciliationSets::Difference(mine, his, iMiss, heMisses);
+          heMisses.insert(heMisses.end(), iMiss.begin(), iMiss.end());
+          FinishSketchReconciliation(peer, heMisses);
+          break;
+        }
+
+        std::vector<int> peerSet;
+        m_reconciliationSets.Take(slot, peerSet);
+        m_reconcileInFlight[slot] = 0;
+        m_peerStatistics[slot].numReconcilUnanswered = 0;
+        std::vector<int> hisSet(msg.txs);
+        std::sort(peerSet.begin(), peerSet.end());
+        std::sort(hisSet.begin(), hisSet.end());
+        std::vector<int> iMiss, heMisses;
+        ReconciliationSets::Difference(peerSet, hisSet, iMiss, heMisses);
+
+        int mySubSetSize[SUB_SETS] = {0};
+        int hisSubSetSize[SUB_SETS] = {0};
+        for (int txId: msg.txs) {
+            hisSubSetSize[MurmurHash3Mixer(txId) % SUB_SETS]++;
+            PeerKnowsTx(txId, slot);
+        }
+        for (int it: peerSet)
+            mySubSetSize[MurmurHash3Mixer(it) % SUB_SETS]++;
+
+        int iMissCounter = 0;
+        for (int txId: iMiss) {
+            if (knownTxHashes.Contains(txId))
+              continue;
+            iMissCounter++;
+            SaveTxData(txId, peer, RECON_HOP);
+            // AdvertiseTransactionInvWrapper(peer, txId, 0);
+        }
+        // Do not inv to out peer, it will learn it later ???
+        // Due to assymetry in the network
+        for (int it: heMisses)
+            ScheduleInvToNode(peer, it, RECON_HOP);
+        int heMissCounter = heMisses.size();
+        int totalDiff = iMissCounter + heMissCounter;
+        if (m_timeToRun < Simulator::Now().GetSeconds() + TIME_NOT_TO_COUNT)
+          break;
+
+        // int estimatedDiff = (EstimateDifference(peerSet.size(), msg.txs.size(), 0.1) * m_protocolSettings.qEstimationMultiplier +
+        //   m_reconciliationHistory[peer] * (1-m_protocolSettings.qEstimationMultiplier));
+
+        // int estimatedDiff = 0;
+        // for (int i = 0; i < SUB_SETS; i++) {
+        //   estimatedDiff += EstimateDifference(mySubSetSize[i], hisSubSetSize[i], 0.1);
+        // }
+
+        int mySetSize = peerSet.size();
+        int hisSetSize = msg.txs.size();
+        m_prevA = m_prevA_per_peer[slot];
+        int estimatedDiff = EstimateDifference(mySetSize, hisSetSize, m_prevA) + m_protocolSettings.qEstimationMultiplier;
+        if (mySetSize * hisSetSize != 0 && estimatedDiff >= mySetSize + hisSetSize) {
+          m_prevA = (totalDiff-std::abs(mySetSize - hisSetSize)) / std::min(mySetSize, hisSetSize);
+          m_prevA_per_peer[slot] = m_prevA;
+        }
+
+        reconcilItem item;
+        item.setInSize = msg.txs.size();
+        item.setOutSize = peerSet.size();
+        item.diffSize = totalDiff;
+        item.estimatedDiff = estimatedDiff;
+        item.outcome = 0;
+        item.syndromes = 0;
+        item.fallbackSize = 0;
+        item.latency = 0;
+        item.nodeId = m_nodeStats->nodeId;
+        m_nodeStats->reconcilData.push_back(item);
+        m_nodeStats->reconcils++;
+        // m_reconciliationHistory[peer] = totalDiff;
+        break;
+    }
+    case RECONCILE_SKETCH:
+    {
+        sketchReconcilState &state = m_sketchesReceived[peer];
+        state.startTime = Simulator::Now().GetSeconds();
+        state.capacity = msg.sketch.size();
+        state.peerSketch = msg.sketch;
+        state.peerSetSize = msg.setSize;
+        state.bisected = false;
+        state.fellBack = false;
+
+        auto delay = PoissonNextSend(1) + 2;
+        Simulator::Schedule (Seconds(delay), &BitcoinNode::RespondToReconciliationSketch, this, peer);
+        break;
+    }
+    case RECONCILE_BISECTION_REQUEST:
+    {
+        auto it = m_sketchesSent.find(peer);
+        if (it == m_sketchesSent.end())
+          break;
+        it->second.bisected = true;
+
+        bitcoinMessage bisectionData;
+        bisectionData.type = RECONCILE_BISECTION_SKETCH;
+        bisectionData.setSize = 0;
+        BitcoinSketch lower (it->second.capacity);
+        for (int tx: it->second.snapshot) {
+          if ((MurmurHash3Mixer(tx) & 1) == 0) {
+            lower.Add(BitcoinSketch::ElementOf(tx));
+            bisectionData.setSize++;
+          }
+        }
+        bisectionData.sketch = lower.GetSyndromes();
+        SendMessage(bisectionData, peer);
+        break;
+    }
+    case RECONCILE_BISECTION_SKETCH:
+    {
+        auto it = m_sketchesReceived.find(peer);
+        if (it == m_sketchesReceived.end())
+          break;
+
+        // The sketch of the upper half of the initiator's set is the full sketch minus the lower half
+        BitcoinSketch lower (msg.sketch);
+        BitcoinSketch upper (it->second.peerSketch);
+        upper.Merge(lower);
+        for (int tx: it->second.snapshot) {
+          if ((MurmurHash3Mixer(tx) & 1) == 0)
+            lower.Add(BitcoinSketch::ElementOf(tx));
+          else
+            upper.Add(BitcoinSketch::ElementOf(tx));
+        }
+
+        std::vector<uint32_t> lowerElements, upperElements;
+        if (lower.Decode(lowerElements) && upper.Decode(upperElements)) {
+          std::vector<int> diff;
+          for (uint32_t element: lowerElements)
+            diff.push_back(BitcoinSketch::TxOf(element));
+          for (uint32_t element: upperElements)
+            diff.push_back(BitcoinSketch::TxOf(element));
+          FinishSketchReconciliation(peer, diff);
+          break;
+        }
+
+        it->second.fellBack = true;
+        bitcoinMessage fallbackData;
+        fallbackData.type = RECONCILE_FALLBACK_REQUEST;
+        SendMessage(fallbackData, peer);
+        break;
+    }
+    case RECONCILE_FALLBACK_REQUEST:
+    {
+        auto it = m_sketchesSent.find(peer);
+        if (it == m_sketchesSent.end())
+          break;
+        it->second.fellBack = true;
+
+        bitcoinMessage reconcileData;
+        reconcileData.type = RECONCILE_TX_RESPONSE;
+        reconcileData.txs = it->second.snapshot;
+        SendMessage(reconcileData, peer);
+        break;
+    }
+    case RECONCILE_DIFF:
+    {
+        auto it = m_sketchesSent.find(peer);
+        if (it == m_sketchesSent.end())
+          break;
+        sketchReconcilState state = it->second;
+        m_sketchesSent.erase(it);
+        // Our set may have reached the threshold during the exchange
+        m_reconcileInFlight[slot] = 0;
+        m_peerStatistics[slot].numReconcilUnanswered = 0;
+        Simulator::ScheduleNow (&BitcoinNode::CheckReconciliationThreshold, this, slot);
+
+        std::set<int> mine(state.snapshot.begin(), state.snapshot.end());
+        std::set<int> diff(msg.txs.begin(), msg.txs.end());
+        for (int txId: msg.txs) {
+          if (mine.find(txId) != mine.end()) {
+            ScheduleInvToNode(peer, txId, RECON_HOP);
+            continue;
+          }
+          PeerKnowsTx(txId, slot);
+          if (!knownTxHashes.Contains(txId))
+            SaveTxData(txId, peer, RECON_HOP);
+        }
+        for (int txId: state.snapshot) {
+          if (diff.find(txId) == diff.end())
+            PeerKnowsTx(txId, slot);
+        }
+
+        int mySetSize = state.snapshot.size();
+        int hisSetSize = msg.setSize;
+        int totalDiff = msg.txs.size();
+        m_peerSetSizes[slot] = hisSetSize;
+        if (mySetSize * hisSetSize != 0) {
+          m_prevA = std::max(0.0, (totalDiff - std::abs(mySetSize - hisSetSize)) * 1.0 / std::min(mySetSize, hisSetSize));
+          m_prevA_per_peer[slot] = m_prevA;
+        }
+
+        if (m_timeToRun < Simulator::Now().GetSeconds() + TIME_NOT_TO_COUNT)
+          break;
+
+        reconcilItem item;
+        item.setInSize = hisSetSize;
+        item.setOutSize = mySetSize;
+        item.diffSize = totalDiff;
+        item.estimatedDiff = state.capacity;
+        item.outcome = state.fellBack ? 3 : (state.bisected ? 2 : 1);
+        item.syndromes = state.bisected ? 2 * state.capacity : state.capacity;
+        item.fallbackSize = state.fellBack ? mySetSize : 0;
+        item.latency = Simulator::Now().GetSeconds() - state.startTime;
+        item.nodeId = m_nodeStats->nodeId;
+        m_nodeStats->reconcilData.push_back(item);
+        m_nodeStats->reconcils++;
+        break;
+    }
+    case INV:
+    {
+      std::vector<std::string>            requestTxs;
+      for (int j=0; j<msg.txs.size(); j++)
+      {
+        int   parsedInv = msg.txs[j];
+        int   hopNumber = msg.hop;
+        m_peerStatistics[slot].numInvReceived++;
+        if (peersKnowTx.Knows(parsedInv, slot))
+          m_nodeStats->onTheFlyCollisions++;
+        if (hopNumber == RECON_HOP ) {
+          m_nodeStats->reconInvReceivedMessages++;
+        } else {
+          m_nodeStats->invReceivedMessages++;
+          if (!FilterCovers(requestedFilterBegin[slot], requestedFilterEnd[slot], FilterPosition(parsedInv)))
+            m_nodeStats->ignoredFilters++;
+        }
+        PeerKnowsTx(parsedInv, slot);
+        if (m_protocolSettings.reconciliationMode != RECON_OFF) {
+          RemoveFromReconciliationSets(parsedInv, peer);
+        }
+
+        bool known = knownTxHashes.Contains(parsedInv);
+        if (hopNumber != RECON_HOP)
+          UpdatePeerScore(slot, !known);
+
+        if (known) {
+            // loop handling
+            if (hopNumber == RECON_HOP ) {
+              m_nodeStats->reconUselessInvReceivedMessages++;
+            } else {
+              m_nodeStats->uselessInvReceivedMessages++;
+            }
+            // A stem transaction we relayed is out in the fluff phase, so relay it as any other
+            if (!m_embargoes.empty() && m_embargoes.find(parsedInv) != m_embargoes.end())
+              FluffTransaction(parsedInv, slot, hopNumber + 1);
+            // if (std::find(loopHistory.begin(), loopHistory.end(), parsedInv) == loopHistory.end() &&
+            //   m_protocolSettings.loopAccommodation == 1) {
+            //   loopHistory.push_back(parsedInv);
+            //   AdvertiseTransactionInvWrapper(from, parsedInv, hopNumber + 1);
+            // }
+            continue;
+        } else {
+          SaveTxData(parsedInv, peer, hopNumber);
+          AdvertiseTransactionInvWrapper(from, parsedInv, hopNumber + 1);
+        }
+      }
+      break;
+    }
+    case DANDELION_TX:
+    {
+      for (int txId: msg.txs)
+      {
+        PeerKnowsTx(txId, slot);
+        if (knownTxHashes.Contains(txId))
+          continue;
+        SaveTxData(txId, peer, msg.hop, false);
+        RelayStemTransaction(txId, slot, msg.hop + 1);
+      }
+      break;
+    }
+    case CMPCT_BLOCK:
+    {
+      // The peer holds every transaction of the block, so it is not told about them again
+      for (int txId: msg.txs)
+        PeerKnowsTx(txId, slot);
+      if (m_knownBlocks.Contains(msg.block))
+        break;
+      m_knownBlocks.Insert(msg.block);
+
+      bitcoinMessage request;
+      request.type = GET_BLOCK_TXN;
+      request.block = msg.block;
+      for (int txId: msg.txs) {
+        if (!knownTxHashes.Contains(txId))
+          request.txs.push_back(txId);
+      }
+      if (request.txs.empty()) {
+        CompleteBlock(msg.block, msg.txs, slot);
+        break;
+      }
+
+      m_nodeStats->blockRoundTrips++;
+      m_nodeStats->blockTxsMissing += request.txs.size();
+      pendingBlock &pending = m_pendingBlocks[msg.block];
+      pending.txs = msg.txs;
+      pending.fromSlot = slot;
+      SendMessage(request, peer);
+      break;
+    }
+    case GET_BLOCK_TXN:
+    {
+      // We relayed the block, so we hold all of its transactions
+      bitcoinMessage response;
+      response.type = BLOCK_TXN;
+      response.block = msg.block;
+      response.txs = msg.txs;
+      SendMessage(response, peer);
+      break;
+    }
+    case BLOCK_TXN:
+    {
+      auto it = m_pendingBlocks.find(msg.block);
+      if (it == m_pendingBlocks.end())
+        break;
+      // The transactions come with the block, they are confirmed and not relayed
+      for (int txId: msg.txs) {
+        PeerKnowsTx(txId, slot);
+        if (!knownTxHashes.Contains(txId))
+          SaveTxData(txId, peer, BLOCK_HOP, false);
+      }
+      pendingBlock pending;
+      pending.txs.swap(it->second.txs);
+      pending.fromSlot = it->second.fromSlot;
+      m_pendingBlocks.erase(it);
+      CompleteBlock(msg.block, pending.txs, pending.fromSlot);
+      break;
+    }
+    default:
+      BITCOIN_TRACE_INFO ("Default");
+      break;
   }
 }
 
@@ -753,24 +1437,29 @@ BitcoinNode::AdvertiseTransactionInvWrapper (Address from, const int transaction
             AdvertiseNewTransactionInvStandard(ipv4From, transactionHash, hopNumber);
             break;
         }
+        case FILTERS_ON_INCOMING_LINKS:
+        case OUTGOING_FILTERS:
+        {
+            AdvertiseNewTransactionInvFiltered(ipv4From, transactionHash, hopNumber);
+            break;
+        }
         case PREFERRED_OUT_DESTINATIONS:
         {
-			       AdvertiseNewTransactionInv(ipv4From, transactionHash, hopNumber, m_outPeers, m_protocolSettings.lowfanoutOrderOut);
+             AdvertiseNewTransactionInv(ipv4From, transactionHash, hopNumber, m_outRanking, m_protocolSettings.lowfanoutOrderOut);
              break;
         }
         case PREFERRED_ALL_DESTINATIONS:
         {
-             AdvertiseNewTransactionInv(ipv4From, transactionHash, hopNumber, m_outPeers, m_protocolSettings.lowfanoutOrderOut);
-             AdvertiseNewTransactionInv(ipv4From, transactionHash, hopNumber, m_inPeers, m_protocolSettings.lowfanoutOrderInPercent);
-			       // AdvertiseNewTransactionInv(ipv4From, transactionHash, hopNumber, m_inPeers,
-             //   floor(m_protocolSettings.lowfanoutOrderInPercent * 1.0 / 100.0 * m_inPeers.size()));
+             AdvertiseNewTransactionInv(ipv4From, transactionHash, hopNumber, m_outRanking, m_protocolSettings.lowfanoutOrderOut);
+             AdvertiseNewTransactionInv(ipv4From, transactionHash, hopNumber, m_inRanking,
+               m_protocolSettings.lowfanoutOrderInPercent * m_inRanking.Size() / 100);
              break;
         }
         case DANDELION_MAPPING:
         {
-            // AdvertiseNewTransactionInv(ipv4From, transactionHash, hopNumber, m_dandelionDestinations[ipv4From],
-            //    m_dandelionDestinations[ipv4From].size());
-             break;
+            // The stem phase goes through DANDELION_TX messages, the INVs are the fluff phase
+            AdvertiseNewTransactionInvStandard(ipv4From, transactionHash, hopNumber);
+            break;
         }
     }
 }
@@ -780,35 +1469,135 @@ void
 BitcoinNode::RespondToReconciliationRequest(Ipv4Address from)
 {
   NS_LOG_FUNCTION (this);
-  Ipv4Address peer = InetSocketAddress::ConvertFrom(from).GetIpv4();
+  Ipv4Address peer = from;
+  uint32_t slot = GetPeerSlot(peer);
 
-  rapidjson::Document reconcileData;
-  reconcileData.SetObject();
+  bitcoinMessage reconcileData;
+  reconcileData.type = RECONCILE_TX_RESPONSE;
+  m_reconciliationSets.Take(slot, reconcileData.txs);
 
-  rapidjson::Value msg;
-  rapidjson::Value txArray(rapidjson::kArrayType);
+  for (int it: reconcileData.txs) {
+      PeerKnowsTx(it, slot);
+  }
+  SendMessage(reconcileData, peer);
+}
 
-  rapidjson::Document::AllocatorType& allocator = reconcileData.GetAllocator();
+void
+BitcoinNode::SendReconciliationSketch(Ipv4Address peer)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Wait for the pending reconciliation with this peer to complete
+  if (m_sketchesSent.find(peer) != m_sketchesSent.end())
+    return;
+
+  uint32_t slot = GetPeerSlot(peer);
+  sketchReconcilState &state = m_sketchesSent[peer];
+  state.startTime = Simulator::Now().GetSeconds();
+  state.snapshot.clear();
+  m_reconciliationSets.Take(slot, state.snapshot);
+  state.bisected = false;
+  state.fellBack = false;
+
+  int mySetSize = state.snapshot.size();
+  int hisSetSize = m_peerSetSizes[slot] >= 0 ? m_peerSetSizes[slot] : mySetSize;
+  // One syndrome more than the estimate, which the decoder keeps to verify the difference.
+  // The difference can not exceed both sets together.
+  int estimate = EstimateDifference(mySetSize, hisSetSize, m_prevA_per_peer[slot]) + m_protocolSettings.qEstimationMultiplier;
+  state.capacity = std::min(std::min(estimate, mySetSize + hisSetSize), SKETCH_MAX_CAPACITY - 1) + 1;
+  state.peerSetSize = hisSetSize;
+  Simulator::Schedule (Seconds(SKETCH_TIMEOUT_SECONDS), &BitcoinNode::ExpireReconciliationSketch, this, peer, state.startTime);
+
+  BitcoinSketch sketch (state.capacity);
+  for (int tx: state.snapshot)
+    sketch.Add(BitcoinSketch::ElementOf(tx));
+
+  bitcoinMessage sketchData;
+  sketchData.type = RECONCILE_SKETCH;
+  sketchData.setSize = mySetSize;
+  sketchData.sketch = sketch.GetSyndromes();
+  SendMessage(sketchData, peer);
+  m_peerStatistics[slot].numReconcilUnanswered++;
+}
+
+void
+BitcoinNode::ExpireReconciliationSketch(Ipv4Address peer, double startTime)
+{
+  auto it = m_sketchesSent.find(peer);
+  if (it == m_sketchesSent.end() || it->second.startTime != startTime)
+    return;
+
+  uint32_t slot = GetPeerSlot(peer);
+  BITCOIN_TRACE_INFO ("Node " << GetNode()->GetId() << " gave up the sketch reconciliation with " << peer);
+
+  std::vector<uint32_t> peers(1, slot);
+  for (int tx: it->second.snapshot) {
+    if (!peersKnowTx.Knows(tx, slot))
+      m_reconciliationSets.Insert(tx, peers);
+  }
+  m_sketchesSent.erase(it);
+  m_reconcileInFlight[slot] = 0;
+  Simulator::ScheduleNow (&BitcoinNode::CheckReconciliationThreshold, this, slot);
+}
+
+void
+BitcoinNode::RespondToReconciliationSketch(Ipv4Address from)
+{
+  NS_LOG_FUNCTION (this);
+  Ipv4Address peer = from;
+  uint32_t slot = GetPeerSlot(peer);
+
+  auto it = m_sketchesReceived.find(peer);
+  if (it == m_sketchesReceived.end())
+    return;
+
+  sketchReconcilState &state = it->second;
+  state.snapshot.clear();
+  m_reconciliationSets.Take(slot, state.snapshot);
 
-  msg = RECONCILE_TX_RESPONSE;
-  reconcileData.AddMember("message", msg, allocator);
+  BitcoinSketch sketch (state.peerSketch);
+  for (int tx: state.snapshot)
+    sketch.Add(BitcoinSketch::ElementOf(tx));
 
-  for (int it: m_peerReconciliationSets[peer]) {
-      rapidjson::Value txhash;
-      txhash.SetInt(it);
-      txArray.PushBack(txhash,allocator);
-      peersKnowTx[it].push_back(peer);
+  std::vector<uint32_t> elements;
+  if (sketch.Decode(elements)) {
+    std::vector<int> diff;
+    for (uint32_t element: elements)
+      diff.push_back(BitcoinSketch::TxOf(element));
+    FinishSketchReconciliation(peer, diff);
+    return;
   }
-  reconcileData.AddMember("transactions", txArray, allocator);
-  rapidjson::StringBuffer reconcileInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> reconcileWriter(reconcileInfo);
-  reconcileData.Accept(reconcileWriter);
 
-  const uint8_t delimiter[] = "#";
-  m_peersSockets[peer]->Send(reinterpret_cast<const uint8_t*>(reconcileInfo.GetString()), reconcileInfo.GetSize(), 0);
-  m_peersSockets[peer]->Send(delimiter, 1, 0);
+  state.bisected = true;
+  bitcoinMessage bisectionData;
+  bisectionData.type = RECONCILE_BISECTION_REQUEST;
+  SendMessage(bisectionData, peer);
+}
+
+void
+BitcoinNode::FinishSketchReconciliation(Ipv4Address peer, const std::vector<int> &diff)
+{
+  NS_LOG_FUNCTION (this);
+
+  auto it = m_sketchesReceived.find(peer);
+  if (it == m_sketchesReceived.end())
+    return;
+
+  uint32_t slot = GetPeerSlot(peer);
 
-  m_peerReconciliationSets[peer].clear();
+  // The initiator either holds our transactions or gets the missing ones along with the difference,
+  // and announces the ones we miss.
+  for (int tx: it->second.snapshot)
+    PeerKnowsTx(tx, slot);
+
+  bitcoinMessage diffData;
+  diffData.type = RECONCILE_DIFF;
+  diffData.setSize = it->second.snapshot.size();
+  diffData.txs = diff;
+  SendMessage(diffData, peer);
+
+  m_peerSetSizes[slot] = it->second.peerSetSize;
+  m_sketchesReceived.erase(it);
 }
 
 
@@ -816,146 +1605,397 @@ void
 BitcoinNode::AdvertiseNewTransactionInvStandard(Ipv4Address from, const int transactionHash, int hopNumber)
 {
   NS_LOG_FUNCTION (this);
-  assert(m_protocolSettings.protocol == STANDARD_PROTOCOL);
-  for (Ipv4Address i: m_peersAddresses)
+  assert(m_protocolSettings.protocol == STANDARD_PROTOCOL || m_protocolSettings.protocol == DANDELION_MAPPING);
+  for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++)
   {
+    Ipv4Address i = m_peersAddresses[slot];
     if (i != from)
+      ScheduleInvToNode(i, transactionHash, hopNumber);
+  }
+}
+
+void
+BitcoinNode::AdvertiseNewTransactionInvFiltered(Ipv4Address from, const int transactionHash, int hopNumber)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t position = FilterPosition(transactionHash);
+  for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++)
+  {
+    Ipv4Address i = m_peersAddresses[slot];
+    if (i == from)
+      continue;
+    if (!FilterCovers(filterBegin[slot], filterEnd[slot], position))
     {
-      double delay = 0.1;
-      if (std::find(m_outPeers.begin(), m_outPeers.end(), i) == m_outPeers.end())
-        delay += PoissonNextSend(m_protocolSettings.invIntervalSeconds);
-      else
-        delay += PoissonNextSendIncoming(m_protocolSettings.invIntervalSeconds >> 1);
-      Simulator::Schedule (Seconds(delay), &BitcoinNode::SendInvToNode, this, i, transactionHash, hopNumber);
+      m_nodeStats->filteredInvs++;
+      continue;
     }
+
+    ScheduleInvToNode(i, transactionHash, hopNumber);
   }
 }
 
 void
-BitcoinNode::AdvertiseNewTransactionInv(Ipv4Address from, const int transactionHash, int hopNumber, std::vector<Ipv4Address> peers, int peersToRelayTo)
+BitcoinNode::AdvertiseNewTransactionInv(Ipv4Address from, const int transactionHash, int hopNumber, const PeerRanking &ranking, int peersToRelayTo)
 {
     NS_LOG_FUNCTION (this);
-    if (peers.size() < peersToRelayTo)
-      return;
-    // does not stuck in endless loop
-    int tries = peers.size();
-    while (peersToRelayTo > 0) {
-      auto preferredPeer = ChooseFromPeers(peers);
-      bool fromPeer = (preferredPeer == from);
-      // avoid unexpected behaviour due to unordered messages
-      bool recentlyReconciled = (preferredPeer == m_reconcilePeers.front() || preferredPeer == m_reconcilePeers.back());
-      bool alreadyKnows = std::find(peersKnowTx[transactionHash].begin(), peersKnowTx[transactionHash].end(), preferredPeer) != peersKnowTx[transactionHash].end();
-      if (fromPeer || recentlyReconciled || alreadyKnows) {
-        tries--;
-        if (tries == 0)
-          break;
-        else
-          continue;
-      }
-      double delay = 0.1;
-      delay += PoissonNextSend(m_protocolSettings.invIntervalSeconds);
-      Simulator::Schedule (Seconds(delay), &BitcoinNode::SendInvToNode, this, preferredPeer, transactionHash, hopNumber);
-      peersToRelayTo--;
-      tries = peers.size();
+    uint32_t fromSlot = GetPeerSlot(from);
+    // avoid unexpected behaviour due to unordered messages
+    uint32_t reconciledFirst = m_peersAddresses.size(), reconciledLast = m_peersAddresses.size();
+    if (!m_reconcilePeers.empty()) {
+      reconciledFirst = GetPeerSlot(m_reconcilePeers.front());
+      reconciledLast = GetPeerSlot(m_reconcilePeers.back());
+    }
+
+    // Keep the eligible peers once, in the order of the ranking, then relay to the first ones
+    m_rankBuffer.clear();
+    ranking.Best(ranking.Size(), m_rankBuffer);
+    size_t eligible = 0;
+    for (uint32_t slot: m_rankBuffer) {
+      if (slot == fromSlot || slot == reconciledFirst || slot == reconciledLast ||
+          (m_protocolSettings.bhDetection && IsBlackHole(slot)) || peersKnowTx.Knows(transactionHash, slot))
+        continue;
+      m_rankBuffer[eligible++] = slot;
     }
+
+    size_t relayed = std::min<size_t>(std::max(peersToRelayTo, 0), eligible);
+    for (size_t i = 0; i < relayed; i++)
+      ScheduleInvToNode(m_peersAddresses[m_rankBuffer[i]], transactionHash, hopNumber);
 }
 
 void
 BitcoinNode::SendInvToNode(Ipv4Address receiver, const int transactionHash, int hopNumber) {
-  bool alreadyKnows = std::find(peersKnowTx[transactionHash].begin(), peersKnowTx[transactionHash].end(), receiver) != peersKnowTx[transactionHash].end();
+  uint32_t slot = GetPeerSlot(receiver);
+  m_pendingInvs[slot].erase(transactionHash);
 
+  bool alreadyKnows = peersKnowTx.Knows(transactionHash, slot);
   if (alreadyKnows)
+  {
+    m_nodeStats->invEventsCancelled++;
     return;
+  }
+  m_nodeStats->invEventsExecuted++;
+  m_peerStatistics[slot].numInvSent++;
 
-  rapidjson::Document inv;
-  inv.SetObject();
-  rapidjson::Value value;
+  bitcoinMessage inv;
+  inv.type = INV;
+  inv.hop = hopNumber;
+  inv.txs.push_back(transactionHash);
+  SendMessage(inv, receiver);
 
-  value = INV;
-  inv.AddMember("message", value, inv.GetAllocator());
+  peersKnowTx.Add(transactionHash, slot);
+  RemoveFromReconciliationSets(transactionHash, receiver);
+}
 
+void
+BitcoinNode::PeerKnowsTx(int txId, uint32_t slot)
+{
+  peersKnowTx.Add(txId, slot);
 
-  rapidjson::Value array(rapidjson::kArrayType);
-  value.SetInt(transactionHash);
-  array.PushBack(value, inv.GetAllocator());
-  inv.AddMember("inv", array, inv.GetAllocator());
+  std::unordered_map<int, EventId> &pending = m_pendingInvs[slot];
+  if (pending.empty())
+    return;
 
-  value = hopNumber;
-  inv.AddMember("hop", value, inv.GetAllocator());
+  auto it = pending.find(txId);
+  if (it == pending.end())
+    return;
+  Simulator::Cancel(it->second);
+  pending.erase(it);
+  m_nodeStats->invEventsCancelled++;
+}
 
+double
+BitcoinNode::InvDelay(uint32_t slot, int hopNumber)
+{
+  if (hopNumber == RECON_HOP)
+    return 0.1;
+
+  // The PREFERRED protocols trickle to all of their peers alike
+  bool preferred = m_protocolSettings.protocol == PREFERRED_OUT_DESTINATIONS ||
+    m_protocolSettings.protocol == PREFERRED_ALL_DESTINATIONS;
+  if (!m_peerIsOutbound[slot] || preferred)
+    return 0.1 + PoissonNextSend(m_protocolSettings.invIntervalSeconds);
+  return 0.1 + PoissonNextSendIncoming(m_protocolSettings.invIntervalSeconds >> 1);
+}
 
-  rapidjson::StringBuffer invInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> invWriter(invInfo);
-  inv.Accept(invWriter);
-  const uint8_t delimiter[] = "#";
-  m_peersSockets[receiver]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
-  m_peersSockets[receiver]->Send (delimiter, 1, 0);
+void
+BitcoinNode::ScheduleInvToNode(Ipv4Address receiver, const int transactionHash, int hopNumber)
+{
+  uint32_t slot = GetPeerSlot(receiver);
+  if (slot == m_peersAddresses.size() || (m_protocolSettings.bhDetection && IsBlackHole(slot)))
+    return;
 
-  peersKnowTx[transactionHash].push_back(receiver);
-  RemoveFromReconciliationSets(transactionHash, receiver);
+  if (m_protocolSettings.invBatchSize == 0)
+  {
+    double delay = InvDelay(slot, hopNumber);
+    // Of two announcements of a transaction to a peer only the first one to fire would be sent
+    EventId &event = m_pendingInvs[slot][transactionHash];
+    if (event.IsRunning())
+    {
+      if (Simulator::GetDelayLeft(event) <= Seconds(delay))
+        return;
+      Simulator::Cancel(event);
+    }
+    event = Simulator::Schedule (Seconds(delay), &BitcoinNode::SendInvToNode, this, receiver, transactionHash, hopNumber);
+    return;
+  }
+
+  invItem item;
+  item.txHash = transactionHash;
+  item.hopNumber = hopNumber;
+  m_invQueues[slot].push_back(item);
+
+  // The delay is only drawn to arm the timer, and the announcements of a reconciliation pull it in
+  EventId &trickleTimer = m_invTrickleTimers[slot];
+  if (trickleTimer.IsRunning())
+  {
+    if (hopNumber != RECON_HOP || Simulator::GetDelayLeft(trickleTimer) <= Seconds(InvDelay(slot, hopNumber)))
+      return;
+    Simulator::Cancel(trickleTimer);
+  }
+  trickleTimer = Simulator::Schedule (Seconds(InvDelay(slot, hopNumber)), &BitcoinNode::FlushInvQueue, this, receiver);
+}
+
+void
+BitcoinNode::FlushInvQueue(Ipv4Address receiver)
+{
+  uint32_t slot = GetPeerSlot(receiver);
+  std::vector<invItem> &queue = m_invQueues[slot];
+
+  // An INV carries a single hop number, so announce the inventories of each hop number together
+  std::stable_sort(queue.begin(), queue.end(),
+    [](const invItem &a, const invItem &b) { return a.hopNumber < b.hopNumber; });
+
+  bitcoinMessage inv;
+  inv.type = INV;
+  for (auto item: queue)
+  {
+    bool alreadyKnows = peersKnowTx.Knows(item.txHash, slot);
+    if (alreadyKnows)
+    {
+      m_nodeStats->invEventsCancelled++;
+      continue;
+    }
+    m_nodeStats->invEventsExecuted++;
+    m_peerStatistics[slot].numInvSent++;
+
+    if (!inv.txs.empty() && (inv.hop != item.hopNumber || int(inv.txs.size()) == m_protocolSettings.invBatchSize))
+    {
+      SendMessage(inv, receiver);
+      inv.txs.clear();
+    }
+    inv.hop = item.hopNumber;
+    inv.txs.push_back(item.txHash);
+
+    peersKnowTx.Add(item.txHash, slot);
+    RemoveFromReconciliationSets(item.txHash, receiver);
+  }
+
+  if (!inv.txs.empty())
+    SendMessage(inv, receiver);
+  queue.clear();
 }
 
 void
-BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, rapidjson::Document &d, Address &outgoingAddress)
+BitcoinNode::SendMessage(const bitcoinMessage &msg, Ptr<Socket> outgoingSocket)
 {
   NS_LOG_FUNCTION (this);
 
-  const uint8_t delimiter[] = "#";
+  if (m_protocolSettings.wireFormat == VIRTUAL_WIRE)
+  {
+    /**
+     * Only the header is serialized, the message waits in the store and the rest of the size
+     * of the real bitcoin message is virtual. The socket adds the TCP/IP headers.
+     */
+    Ptr<Packet> packet = BitcoinCodec::EncodeVirtual (msg, GetMessagePayloadSize (msg));
+    outgoingSocket->Send (packet);
+    m_nodeStats->txBytes[msg.type] += packet->GetSize ();
+    CountSend (msg.type, packet->GetSize ());
+    return;
+  }
+
+  if (m_protocolSettings.coalesceWindowMs > 0)
+  {
+    /**
+     * The frames sent to the peer during the window leave together with the first one
+     */
+    std::pair<enum Messages, std::string> &queue = m_txQueues[PeekPointer (outgoingSocket)];
+    size_t queued = queue.second.size();
 
-  rapidjson::StringBuffer buffer;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    if (queued == 0)
+    {
+      queue.first = msg.type;
+      Simulator::Schedule (MilliSeconds (m_protocolSettings.coalesceWindowMs), &BitcoinNode::FlushTxQueue, this, outgoingSocket);
+    }
+    BitcoinCodec::Encode (msg, m_protocolSettings.wireFormat, queue.second);
+    m_nodeStats->txBytes[msg.type] += queue.second.size() - queued;
+    return;
+  }
 
+  m_txBuffer.clear();
+  BitcoinCodec::Encode (msg, m_protocolSettings.wireFormat, m_txBuffer);
+  outgoingSocket->Send (reinterpret_cast<const uint8_t*>(m_txBuffer.data()), m_txBuffer.size(), 0);
+  m_nodeStats->txBytes[msg.type] += m_txBuffer.size();
+  CountSend (msg.type, m_txBuffer.size());
+}
 
+void
+BitcoinNode::FlushTxQueue(Ptr<Socket> outgoingSocket)
+{
+  NS_LOG_FUNCTION (this);
 
-  d["message"].SetInt(responseMessage);
-  d.Accept(writer);
+  std::pair<enum Messages, std::string> &queue = m_txQueues[PeekPointer (outgoingSocket)];
+
+  outgoingSocket->Send (reinterpret_cast<const uint8_t*>(queue.second.data()), queue.second.size(), 0);
+  CountSend (queue.first, queue.second.size());
+  queue.second.clear();
+}
+
+void
+BitcoinNode::CountSend(enum Messages type, uint32_t size)
+{
+  m_nodeStats->txPackets[type]++;
+  m_nodeStats->txSegments[type] += (size + m_segmentSize - 1) / m_segmentSize;
+}
+
+void
+BitcoinNode::SendMessage(const bitcoinMessage &msg, Ipv4Address receiver)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_channel)
+  {
+    // The channel has no TCP/IP stack, so it is charged with the size of all the headers
+    uint32_t size = m_bitcoinMessageHeader + GetMessagePayloadSize (msg);
+    m_channel->Send (GetNode ()->GetId (), receiver, msg, size);
+    m_nodeStats->txBytes[msg.type] += size;
+    CountSend (msg.type, size);
+    return;
+  }
+  uint32_t slot = GetPeerSlot(receiver);
+  if (slot == m_peersAddresses.size() || !m_peerSockets[slot])
+  {
+    BITCOIN_TRACE_WARN ("Node " << GetNode ()->GetId () << " has no connection to " << receiver);
+    return;
+  }
+  SendMessage(msg, m_peerSockets[slot]);
+}
+
+int
+BitcoinNode::GetMessagePayloadSize (const bitcoinMessage &msg) const
+{
+  if (msg.type == INV || msg.type == RECONCILE_TX_RESPONSE)
+    return m_countBytes + m_inventorySizeBytes * msg.txs.size();
+  // The stem carries the whole transaction
+  if (msg.type == DANDELION_TX)
+    return GetTransactionsSize (msg.txs);
+  // Sketches and differences carry 32 bit syndromes and short transaction ids
+  if (msg.type == RECONCILE_SKETCH || msg.type == RECONCILE_BISECTION_SKETCH)
+    return 2 * m_countBytes + 4 * msg.sketch.size();
+  if (msg.type == RECONCILE_DIFF)
+    return 2 * m_countBytes + 4 * msg.txs.size();
+  // BIP152: the header and a nonce, then 6 Byte short ids, or the block hash and the indices or the transactions
+  if (msg.type == CMPCT_BLOCK)
+    return m_headersSizeBytes + 8 + m_countBytes + 6 * msg.txs.size();
+  if (msg.type == GET_BLOCK_TXN)
+    return 32 + m_countBytes + 2 * msg.txs.size();
+  if (msg.type == BLOCK_TXN)
+    return 32 + m_countBytes + GetTransactionsSize (msg.txs);
+  return m_countBytes;
+}
+
+int
+BitcoinNode::GetTransactionsSize (const std::vector<int> &txs) const
+{
+  const BitcoinTxRegistry &registry = BitcoinTxRegistry::Get ();
+  int size = 0;
+  for (int txId: txs)
+    size += registry.GetSize (txId);
+  return size;
+}
+
+void
+BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, bitcoinMessage &msg, Ptr<Socket> outgoingSocket)
+{
+  NS_LOG_FUNCTION (this);
+
+  msg.type = responseMessage;
+  SendMessage(msg, outgoingSocket);
+}
+
+void
+BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, bitcoinMessage &msg, Address &outgoingAddress)
+{
+  NS_LOG_FUNCTION (this);
 
   Ipv4Address outgoingIpv4Address = InetSocketAddress::ConvertFrom(outgoingAddress).GetIpv4 ();
-  std::map<Ipv4Address, Ptr<Socket>>::iterator it = m_peersSockets.find(outgoingIpv4Address);
 
-  if (it == m_peersSockets.end()) //Create the socket if it doesn't exist
+  if (m_channel)
+  {
+    msg.type = responseMessage;
+    SendMessage(msg, outgoingIpv4Address);
+    return;
+  }
+
+  uint32_t slot = GetPeerSlot(outgoingIpv4Address);
+  if (slot == m_peersAddresses.size())
   {
-    m_peersSockets[outgoingIpv4Address] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
-    m_peersSockets[outgoingIpv4Address]->Connect (InetSocketAddress (outgoingIpv4Address, m_bitcoinPort));
+    BITCOIN_TRACE_WARN ("Node " << GetNode ()->GetId () << ": " << outgoingIpv4Address << " is not a peer");
+    return;
   }
 
-  m_peersSockets[outgoingIpv4Address]->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-  m_peersSockets[outgoingIpv4Address]->Send (delimiter, 1, 0);
+  if (!m_peerSockets[slot]) //Create the socket if it doesn't exist
+  {
+    m_peerSockets[slot] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
+    m_peerSockets[slot]->Connect (InetSocketAddress (outgoingIpv4Address, m_bitcoinPort));
+  }
+
+  SendMessage(receivedMessage, responseMessage, msg, m_peerSockets[slot]);
 }
 
-void BitcoinNode::SaveTxData(int txId, Ipv4Address from, int hopNumber) {
-  assert(std::find(knownTxHashes.begin(), knownTxHashes.end(), txId) == knownTxHashes.end());
+void BitcoinNode::SaveTxData(int txId, Ipv4Address from, int hopNumber, bool pooled) {
+  assert(!knownTxHashes.Contains(txId));
   txRecvTime txTime;
   txTime.nodeId = GetNode()->GetId();
   txTime.txHash = txId;
   txTime.txTime = Simulator::Now().GetSeconds();
   txTime.hopNumber = hopNumber;
   m_nodeStats->txReceivedTimes.push_back(txTime);
-  knownTxHashes.push_back(txId);
+  knownTxHashes.Insert(txId);
   m_nodeStats->txReceived++;
-  if (m_protocolSettings.reconciliationMode != RECON_OFF) {
+  // A stem transaction enters the mempool when it is fluffed
+  if (m_isMiner && pooled)
+    m_mempool.push_back(txId);
+  if (m_protocolSettings.reconciliationMode != RECON_OFF && pooled) {
     AddToReconciliationSets(txId, from);
   }
 }
 
 void BitcoinNode::AddToReconciliationSets(int txId, Ipv4Address from) {
-  if (m_timeToRun < Simulator::Now().GetSeconds() + timeNotToCount)
+  if (m_timeToRun < Simulator::Now().GetSeconds() + TIME_NOT_TO_COUNT)
     return;
 
   // std::cout << "Node " << m_nodeStats->nodeId << " adds tx: " << txId << "from peer" << from << std::endl;
-  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+  m_slotBuffer.clear();
+  for (uint32_t slot = 0; slot < m_peersAddresses.size(); slot++)
   {
-    if (*i == from || peersMode[*i] == BLACK_HOLE) {
+    if (m_peersAddresses[slot] == from || IsBlackHole(slot)) {
       continue;
     }
-    m_peerReconciliationSets[*i].push_back(txId);
+    m_slotBuffer.push_back(slot);
+  }
+  m_reconciliationSets.Insert(txId, m_slotBuffer);
+
+  if (m_protocolSettings.reconciliationMode == SET_SIZE_BASED) {
+    for (uint32_t slot: m_slotBuffer)
+      CheckReconciliationThreshold(slot);
   }
 }
 
 void BitcoinNode::RemoveFromReconciliationSets(int txId, Ipv4Address from) {
-  auto item = std::find(m_peerReconciliationSets[from].begin(), m_peerReconciliationSets[from].end(), txId);
-  if (item != m_peerReconciliationSets[from].end())
-    m_peerReconciliationSets[from].erase(item);
+  uint32_t slot = GetPeerSlot(from);
+  if (slot == m_peersAddresses.size())
+    return;
+  m_reconciliationSets.Remove(txId, slot);
 }
 
 
@@ -963,11 +2003,14 @@ void
 BitcoinNode::HandlePeerClose (Ptr<Socket> socket)
 {
   NS_LOG_FUNCTION (this << socket);
+  // The socket may be freed and its address reused by a new connection
+  m_receiveBuffers.erase (PeekPointer (socket));
 }
 
 void BitcoinNode::HandlePeerError (Ptr<Socket> socket)
 {
   NS_LOG_FUNCTION (this << socket);
+  m_receiveBuffers.erase (PeekPointer (socket));
 }
 
 
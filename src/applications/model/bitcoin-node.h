@@ -6,16 +6,23 @@
 #define BITCOIN_NODE_H
 
 #include <algorithm>
+#include <unordered_map>
 #include "ns3/application.h"
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
 #include "ns3/address.h"
 #include "bitcoin.h"
+#include "bitcoin-message.h"
+#include "bitcoin-channel.h"
+#include "bitcoin-tx-generator.h"
+#include "bitcoin-block-generator.h"
+#include "bitcoin-known-txs.h"
+#include "bitcoin-peers-know-tx.h"
+#include "bitcoin-recon-sets.h"
+#include "bitcoin-peer-ranking.h"
+#include "bitcoin-rng.h"
 #include "ns3/boolean.h"
-#include "../../rapidjson/document.h"
-#include "../../rapidjson/writer.h"
-#include "../../rapidjson/stringbuffer.h"
 
 namespace ns3 {
 
@@ -78,10 +85,32 @@ public:
    * \param nodeStats a reference to a nodeStatistics struct
    */
   void SetNodeStats(nodeStatistics *nodeStats);
+
+  /**
+   * \brief Set the message channel which replaces the TCP sockets
+   * \param channel the channel, or 0 to use sockets
+   */
+  void SetChannel (Ptr<BitcoinChannel> channel);
+
+  /**
+   * \brief Set the generator which hands transactions to the emitters
+   * \param txGenerator the generator, or 0 for a node which never creates transactions
+   */
+  void SetTxGenerator (Ptr<BitcoinTxGenerator> txGenerator);
+
+  /**
+   * \brief Set the generator which hands blocks to the miners
+   * \param blockGenerator the generator, or 0 if no block is mined
+   */
+  void SetBlockGenerator (Ptr<BitcoinBlockGenerator> blockGenerator);
   void SetProperties(uint64_t timeToRun, enum ModeType mode,
     int systemId, std::vector<Ipv4Address> outPeers, ProtocolSettings protocolSettings);
 
 protected:
+  friend class BitcoinChannel;
+  friend class BitcoinTxGenerator;
+  friend class BitcoinBlockGenerator;
+
   virtual void DoDispose (void);           // inherited from Application base class.
 
   virtual void StartApplication (void);    // Called at time specified by Start
@@ -93,6 +122,13 @@ protected:
    */
   void HandleRead (Ptr<Socket> socket);
 
+  /**
+   * \brief Handle a decoded message
+   * \param msg the message
+   * \param from the address of the sender
+   */
+  void HandleMessage (const bitcoinMessage &msg, const Address &from);
+
   /**
    * \brief Handle an incoming connection
    * \param socket the incoming connection socket
@@ -119,46 +155,296 @@ protected:
   int PoissonNextSendIncoming(int averageIntervalSeconds);
 
   void ReconcileWithPeer(void);
-  Ipv4Address ChooseFromPeers(std::vector<Ipv4Address> peers);
-  void UpdatePreferredPeersList(void);
+
+  /**
+   * \brief Starts a reconciliation with a peer, with a sketch or with a request for its set
+   * \param peer the peer
+   */
+  void StartReconciliation(Ipv4Address peer);
+
+  /**
+   * \brief In SET_SIZE_BASED mode, reconciles with an outbound peer once its set reaches the
+   * threshold, unless a reconciliation with the peer is in flight
+   * \param slot the slot of the peer
+   */
+  void CheckReconciliationThreshold(uint32_t slot);
+
+  /**
+   * \brief In SET_SIZE_BASED mode, starts a reconciliation with an outbound peer and restarts the
+   * timer which reconciles with it again after reconciliationMaxDelaySeconds at the latest
+   * \param slot the slot of the peer
+   */
+  void ReconcileBySetSize(uint32_t slot);
+  /**
+   * \brief Counts an INV of a peer as useful if it announced a transaction we did not know, and
+   * moves the peer in its ranking by the new share of its useful INVs
+   * \param slot the slot of the peer
+   * \param useful true if the INV announced a new transaction
+   */
+  void UpdatePeerScore(uint32_t slot, bool useful);
+
+  /**
+   * \return true if the peer is taken for a black hole: by its behaviour with bhInference, else by
+   * its MODE message
+   */
+  bool IsBlackHole(uint32_t slot) const;
+
+  /**
+   * \return true if the node does not reconcile with the peer. A black hole by its MODE message is
+   * skipped, while a peer flagged by bhInference is still reconciled with, so that it is unflagged
+   * once it answers again
+   */
+  bool SkipsReconciliation(uint32_t slot) const;
+
+  /**
+   * \brief With bhInference, flags the peers which relay too little or leave our reconciliations
+   * unanswered, stops relaying to them and drops their reconciliation sets, and clears the flags of
+   * the peers which relay again. Runs every BH_CHECK_SECONDS
+   */
+  void DetectBlackHoles(void);
+  /**
+   * \brief Splits the hash space among the outbound peers which relay, each range widened by the
+   * overlap, and installs the ranges: on our outgoing links with OUTGOING_FILTERS, or on the links of
+   * the peers with FILTERS_ON_INCOMING_LINKS, by sending them the bounds which changed
+   */
   void ValidateNodeFilters(void);
   void UpdateFilterBegin(Ipv4Address& peer, uint32_t newVal);
   void UpdateFilterEnd(Ipv4Address& peer, uint32_t newVal);
+
+  /**
+   * \return the position of a transaction in the hash space of the relay filters
+   */
+  static uint32_t FilterPosition(int txId);
+
+  /**
+   * \return true if the filter [begin, end) covers the position
+   */
+  static bool FilterCovers(uint32_t begin, uint32_t end, uint32_t position)
+  {
+    return (position + FILTER_BASE_NUMBERING - begin) % FILTER_BASE_NUMBERING < end - begin;
+  }
+
+  /**
+   * \return true if [begin, end) is a non-empty filter FilterCovers can test, which may wrap around
+   * the hash space but not cover it more than once
+   */
+  static bool FilterIsValid(int64_t begin, int64_t end)
+  {
+    return begin >= 0 && begin < FILTER_BASE_NUMBERING && end > begin && end <= begin + FILTER_BASE_NUMBERING;
+  }
+
+  /**
+   * \brief Announces a transaction to the peers whose relay filter covers it, the others as usual
+   */
+  void AdvertiseNewTransactionInvFiltered (Ipv4Address from, const int transactionHash, int hopNumber);
   void AnnounceMode(void);
 
-  void ScheduleNextTransactionEvent(void);
-  void EmitTransaction(void);
+  /**
+   * \brief Creates a transaction registered by the transaction generator
+   * \param transactionId the index of the transaction in BitcoinTxRegistry
+   */
+  void EmitTransaction(int transactionId);
+
+  /**
+   * \brief Builds a block of the oldest transactions of the mempool and announces it to every peer
+   * \param block the number of the block
+   */
+  void MineBlock(int block);
 
-  void SaveTxData(int txId, Ipv4Address from, int hopNumber);
+  /**
+   * \brief Counts a block as received, takes its transactions out of the mempool of a miner and out
+   * of the relay, and announces it to every peer but the one it came from
+   * \param fromSlot the slot of that peer, k for our own blocks
+   */
+  void CompleteBlock(int block, const std::vector<int> &txs, uint32_t fromSlot);
+
+  /**
+   * \brief Takes the transactions of a block out of the pending and queued INVs and out of the
+   * reconciliation sets of every peer, since confirmed transactions are not relayed
+   */
+  void ForgetConfirmedTransactions(const std::vector<int> &txs);
+
+  /**
+   * \brief Sends a CMPCT_BLOCK with the ids of the transactions to every peer but one, and but the
+   * black holes we know of
+   * \param fromSlot the slot of that peer, k for none
+   */
+  void RelayBlock(int block, const std::vector<int> &txs, uint32_t fromSlot);
+
+  /**
+   * \return the slot of a peer, in 0..k-1 in the order of m_peersAddresses, or k if the address is not a peer
+   */
+  uint32_t GetPeerSlot(Ipv4Address peer) const;
+
+  /**
+   * \brief Records a new transaction
+   * \param txId the transaction id
+   * \param from the peer it came from, or our own address
+   * \param hopNumber the hop number it came with
+   * \param pooled false for a Dandelion stem transaction, which only joins the mempool and the
+   * reconciliation sets once fluffed, and for a transaction received with a block, which is confirmed
+   */
+  void SaveTxData(int txId, Ipv4Address from, int hopNumber, bool pooled = true);
   void AddToReconciliationSets(int txId, Ipv4Address from);
   void RemoveFromReconciliationSets(int txId, Ipv4Address peer);
 
   void AdvertiseTransactionInvWrapper (Address from, const int transactionHash, int hopNumber);
   void AdvertiseNewTransactionInvStandard (Ipv4Address from, const int transactionHash, int hopNumber);
-  void AdvertiseNewTransactionInv (Ipv4Address from, const int transactionHash, int hopNumber, std::vector<Ipv4Address> peers, int order);
+  /**
+   * \brief Announces a transaction to the best peers of a ranking which may not know it. The peers
+   * are checked once each, then the first eligible ones get the INV.
+   * \param ranking the outbound or the inbound peers
+   * \param order the number of peers to announce it to
+   */
+  void AdvertiseNewTransactionInv (Ipv4Address from, const int transactionHash, int hopNumber, const PeerRanking &ranking, int order);
 
   void SendInvToNode(Ipv4Address receiver, const int transactionHash, int hopNumber);
 
+  /**
+   * \brief Records that a peer knows a transaction, and cancels the pending announcement of the
+   * transaction to the peer, if any
+   * \param txId the transaction id
+   * \param slot the slot of the peer
+   */
+  void PeerKnowsTx(int txId, uint32_t slot);
+
+  /**
+   * \brief Draws the delay of an announcement to a peer: 0.1s for the transactions found by a
+   * reconciliation, and a Poisson delay otherwise
+   * \param slot the slot of the peer
+   * \param hopNumber the hop number of the announcement
+   */
+  double InvDelay(uint32_t slot, int hopNumber);
+
+  /**
+   * \brief Announces a transaction to a peer after the delay given by InvDelay
+   *
+   * Without batching each call schedules its own SendInvToNode event, kept per peer and transaction
+   * until it fires, so that a single one is pending and the peer learning the transaction cancels it.
+   * With batching the transaction joins the peer's INV queue, and a delay is only drawn to arm the
+   * peer's trickle timer when it is not pending, or to bring it forward for a RECON_HOP announcement.
+   */
+  void ScheduleInvToNode(Ipv4Address receiver, const int transactionHash, int hopNumber);
+
+  /**
+   * \brief Sends the queued inventories of a peer, packing up to invBatchSize of them per INV message
+   */
+  void FlushInvQueue(Ipv4Address receiver);
+
   void RespondToReconciliationRequest(Ipv4Address from);
 
+  /**
+   * \brief Starts a sketch reconciliation: takes a snapshot of the reconciliation set of a peer and
+   * sends its sketch, sized by the estimated difference up to SKETCH_MAX_CAPACITY. The reconciliation
+   * expires after SKETCH_TIMEOUT_SECONDS.
+   * \param peer the peer
+   */
+  void SendReconciliationSketch(Ipv4Address peer);
+
+  /**
+   * \brief Gives up a sketch reconciliation the peer did not close in time, and puts the
+   * transactions of its snapshot back into the reconciliation set of the peer
+   * \param peer the peer
+   * \param startTime the start of the reconciliation, which tells it from a later one
+   */
+  void ExpireReconciliationSketch(Ipv4Address peer, double startTime);
+
+  /**
+   * \brief Decodes the sketch received from a peer against our own set, and asks for a bisection
+   * if the difference does not fit
+   * \param from the initiator of the reconciliation
+   */
+  void RespondToReconciliationSketch(Ipv4Address from);
+
+  /**
+   * \brief Sends the decoded difference back to the initiator and closes the reconciliation
+   * \param peer the initiator of the reconciliation
+   * \param diff the transactions which only one of the two sets holds
+   */
+  void FinishSketchReconciliation(Ipv4Address peer, const std::vector<int> &diff);
+
+  /**
+   * \brief Starts a Dandelion++ epoch: picks the outbound peers which carry the stems, and maps each
+   * peer, and our own transactions, to one of them
+   */
   void RotateDandelionDestinations();
+
+  /**
+   * \brief Passes a transaction along the stem, or fluffs it with the fluff probability, and arms its
+   * embargo timer
+   * \param txId the transaction id
+   * \param fromSlot the slot of the peer it came from, k for our own transactions
+   * \param hopNumber the hop number of the outgoing message
+   */
+  void RelayStemTransaction(int txId, uint32_t fromSlot, int hopNumber);
+
+  /**
+   * \brief Ends the stem phase of a transaction: announces it to every peer and adds it to the
+   * reconciliation sets
+   * \param txId the transaction id
+   * \param fromSlot the slot of the peer it came from, which is left out, k for none
+   * \param hopNumber the hop number of the announcements
+   */
+  void FluffTransaction(int txId, uint32_t fromSlot, int hopNumber);
+
+  /**
+   * \brief Fluffs a stem transaction which nobody fluffed before its embargo expired
+   */
+  void EmbargoExpired(int txId, int hopNumber);
+  /**
+   * \brief Encodes a message in the configured wire format and sends it to a peer
+   * \param msg the outgoing message
+   * \param outgoingSocket the socket of the peer
+   */
+  void SendMessage(const bitcoinMessage &msg, Ptr<Socket> outgoingSocket);
+
   /**
    * \brief Sends a message to a peer
    * \param receivedMessage the type of the received message
    * \param responseMessage the type of the response message
-   * \param d the rapidjson document containing the info of the outgoing message
+   * \param msg the outgoing message
    * \param outgoingSocket the socket of the peer
    */
-  void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, rapidjson::Document &d, Ptr<Socket> outgoingSocket);
+  void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, bitcoinMessage &msg, Ptr<Socket> outgoingSocket);
+
+  /**
+   * \brief Sends the frames queued for a peer during the coalescing window with a single Send
+   * \param outgoingSocket the socket of the peer
+   */
+  void FlushTxQueue(Ptr<Socket> outgoingSocket);
+
+  /**
+   * \brief Counts a packet handed to the transport, and the TCP segments it needs
+   * \param type the type of the (first) message of the packet
+   * \param size the packet size
+   */
+  void CountSend(enum Messages type, uint32_t size);
+
+  /**
+   * \brief Sends a message to a peer, through the message channel if there is one
+   * \param msg the outgoing message
+   * \param receiver the Ipv4Address of the peer
+   */
+  void SendMessage(const bitcoinMessage &msg, Ipv4Address receiver);
+
+  /**
+   * \return the size of the payload of the real bitcoin message, excluding its header
+   */
+  int GetMessagePayloadSize (const bitcoinMessage &msg) const;
+
+  /**
+   * \return the size of the transactions, as registered in BitcoinTxRegistry
+   */
+  int GetTransactionsSize (const std::vector<int> &txs) const;
 
   /**
    * \brief Sends a message to a peer
    * \param receivedMessage the type of the received message
    * \param responseMessage the type of the response message
-   * \param d the rapidjson document containing the info of the outgoing message
+   * \param msg the outgoing message
    * \param outgoingAddress the Address of the peer
    */
-  void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, rapidjson::Document &d, Address &outgoingAddress);
+  void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, bitcoinMessage &msg, Address &outgoingAddress);
 
   /**
    * \brief Sends a message to a peer
@@ -180,17 +466,23 @@ protected:
   Time            m_invTimeoutMinutes;                //!< The block timeout in minutes
   double          m_downloadSpeed;                    //!< The download speed of the node in Bytes/s
   double          m_uploadSpeed;                      //!< The upload speed of the node in Bytes/s
-  double          m_averageTransactionSize;           //!< The average transaction size. Needed for compressed blocks
   uint m_fixedTxTimeGeneration;
 
   int m_systemId;
 
-  std::map<ns3::Ipv4Address, uint32_t> filterBegin;        //!< The start of the filter for each peer
-  std::map<ns3::Ipv4Address, uint32_t> filterEnd;          //!< The end of the filter for each peer
-  std::map<Ipv4Address, ModeType> peersMode;
+  /**
+   * Per-peer state lives in vectors indexed by the slot of the peer, 0..k-1, which is its position
+   * in m_peersAddresses and is looked up once per message with GetPeerSlot.
+   */
+  std::vector<uint32_t> filterBegin;        //!< The start of the filter for each peer
+  std::vector<uint32_t> filterEnd;          //!< The end of the filter for each peer
+  std::vector<uint32_t> requestedFilterBegin;   //!< The start of the filter we requested from each peer, with FILTERS_ON_INCOMING_LINKS
+  std::vector<uint32_t> requestedFilterEnd;     //!< The end of the filter we requested from each peer
+  std::vector<ModeType> peersMode;
 
   uint lastTxId;
-  std::vector<int> knownTxHashes;
+  KnownTxSet knownTxHashes;
+  BitcoinRng m_rng;                                   //!< The random numbers of the node, seeded with its id
 
   uint32_t sentOriginalInvs;
   uint32_t retransmittedInvs;
@@ -199,22 +491,47 @@ protected:
 
   double m_prevA;
 
-  std::map<Ipv4Address, double>     m_prevA_per_peer;
+  std::vector<double>   m_prevA_per_peer;
 
 
-  std::map<int, std::vector<Ipv4Address>>     peersKnowTx;
+  PeersKnowTxTable                            peersKnowTx;                      //!< The peers which know each transaction, by peer slot
+  std::unordered_map<uint32_t, uint32_t>      m_peerSlots;                      //!< The slot, 0..k-1, of each peer address
 
-  std::map<Ipv4Address, std::vector<int>>     m_peerReconciliationSets;         //!< Set of all txs we've seen, to be reconciled with peers
+  ReconciliationSets                          m_reconciliationSets;             //!< Set of all txs we've seen, to be reconciled with peers, by peer slot
+  std::vector<uint32_t>                       m_slotBuffer;                     //!< the peers a new tx is added for, reused to avoid reallocations
+  std::map<Ipv4Address, sketchReconcilState>  m_sketchesSent;                   //!< The sketch reconciliations we initiated, until the difference comes back
+  std::map<Ipv4Address, sketchReconcilState>  m_sketchesReceived;               //!< The sketch reconciliations we respond to, until the difference is decoded
+  std::vector<int>                            m_peerSetSizes;                   //!< The set size each peer reported in its last reconciliation, -1 before the first one
   std::list<Ipv4Address>                              m_reconcilePeers;                 //!< Queue holding peers with which we will reconcile
+  std::vector<EventId>                                m_reconcileTimers;                //!< The time cap of the next reconciliation with each peer, in SET_SIZE_BASED mode
+  std::vector<uint8_t>                                m_reconcileInFlight;              //!< 1 for the peers we started a reconciliation with, until the difference comes back
   std::vector<Ipv4Address>                            m_peersAddresses;                 //!< The addresses of peers
   std::map<Ipv4Address, double>                       m_peersDownloadSpeeds;            //!< The peersDownloadSpeeds of channels
   std::map<Ipv4Address, double>                       m_peersUploadSpeeds;              //!< The peersUploadSpeeds of channels
-  std::map<Ipv4Address, peerStatistics>               m_peerStatistics;                 //!< map holding message statistics for each of this node's peers. Used to order peers by some metric.
-  std::vector<Ipv4Address>                            m_preferredPeers;                 //!< List of peers the node deems "preferred" by some metric
-  std::map<Ipv4Address, Ptr<Socket>>                  m_peersSockets;                   //!< The sockets of peers
+  std::vector<peerStatistics>                         m_peerStatistics;                 //!< holding message statistics for each of this node's peers. Used to order peers by some metric.
+  std::vector<uint8_t>                                m_bhSuspects;                     //!< 1 for the peers bhInference takes for black holes
+  Time                                                m_startedAt;                      //!< When the node started, for the black hole detection latency
+  PeerRanking                                         m_outRanking;                     //!< The outbound peers by usefulness, with the PREFERRED protocols
+  PeerRanking                                         m_inRanking;                      //!< The inbound peers by usefulness, with the PREFERRED protocols
+  std::vector<uint32_t>                               m_rankBuffer;                     //!< the best peers of a ranking, reused to avoid reallocations
+  std::vector<uint8_t>                                m_peerIsOutbound;                 //!< 1 for the peers in m_outPeers
+  std::vector<Ptr<Socket>>                            m_peerSockets;                    //!< The sockets of peers
+  Ptr<BitcoinChannel>                                 m_channel;                        //!< The message channel, 0 when the sockets are used
+  Ptr<BitcoinTxGenerator>                             m_txGenerator;                    //!< The transaction generator, 0 if the node creates none
+  Ptr<BitcoinBlockGenerator>                          m_blockGenerator;                 //!< The block generator, 0 if no block is mined
+  bool                                                m_isMiner;                        //!< true if the block generator mines blocks at this node
+  std::vector<int>                                    m_mempool;                        //!< At miners, the transactions no block holds yet, oldest first
+  KnownTxSet                                          m_confirmedTxs;                   //!< At miners, the transactions of the blocks seen
+  KnownTxSet                                          m_knownBlocks;                    //!< The blocks received, requested or mined
+  std::unordered_map<int, pendingBlock>               m_pendingBlocks;                  //!< The compact blocks waiting for their missing transactions
+  std::vector<std::vector<invItem>>                   m_invQueues;                      //!< The inventories waiting for the trickle timer of each peer
+  std::vector<EventId>                                m_invTrickleTimers;               //!< The trickle timer of each peer
+  std::vector<std::unordered_map<int, EventId>>       m_pendingInvs;                    //!< The pending SendInvToNode event of each transaction, by peer slot
   std::map<std::string, EventId>                      m_invTimeouts;                    //!< map holding the event timeouts of inv messages
-  std::map<std::string, EventId>                      m_chunkTimeouts;                  //!< map holding the event timeouts of chunk messages
-  std::map<Address, std::string>                      m_bufferedData;                   //!< map holding the buffered data from previous handleRead events
+  std::unordered_map<Socket*, ReceiveBuffer>          m_receiveBuffers;                 //!< the buffered data from previous handleRead events of each receiving socket
+  bitcoinMessage                                      m_rxMessage;                      //!< the last decoded message, reused to avoid reallocations
+  std::string                                         m_txBuffer;                       //!< the last encoded message, reused to avoid reallocations
+  std::unordered_map<Socket*, std::pair<enum Messages, std::string>> m_txQueues;        //!< the type of the first frame and the frames waiting for the coalescing window of each sending socket
   nodeStatistics                                     *m_nodeStats;                      //!< struct holding the node stats
   enum ModeType                                       m_mode;
 
@@ -230,7 +547,9 @@ protected:
 
   std::vector<Ipv4Address> m_outPeers;
   std::vector<Ipv4Address> m_inPeers;
-  // std::map<Ipv4Address, std::vector<Ipv4Address>> m_dandelionDestinations;
+  std::vector<uint32_t>                  m_outSlots;             //!< The slots of the outbound peers, the stem peers of the epoch first
+  std::vector<uint32_t>                  m_stemDestinations;     //!< The stem peer slot of the epoch for each peer slot, and for our own transactions at k
+  std::unordered_map<int, EventId>       m_embargoes;            //!< The embargo timers of the stem transactions we relayed, until they are fluffed
   // std::map<Ipv4Address, std::vector<int>> m_reconciliationHistory;
 
 
@@ -241,10 +560,10 @@ protected:
   const int       m_bitcoinPort;               //!< 8333
   const int       m_secondsPerMin;             //!< 60
   const int       m_countBytes;                //!< The size of count variable in messages, 4 Bytes
-  const int       m_bitcoinMessageHeader;      //!< The size of the bitcoin Message Header, 90 Bytes, including both the bitcoinMessageHeaders and the other protocol headers (TCP, IP, Ethernet)
+  const int       m_bitcoinMessageHeader;      //!< The size of the bitcoin Message Header, 90 Bytes, including both the bitcoinMessageHeaders and the other protocol headers (TCP, IP, Ethernet). Only charged on the message channel, which has no protocol stack
   const int       m_inventorySizeBytes;        //!< The size of inventories in INV messages, 36 Bytes
-  const int       m_getHeadersSizeBytes;       //!< The size of the GET_HEADERS message, 72 Bytes
   const int       m_headersSizeBytes;          //!< 81 Bytes
+  uint32_t        m_segmentSize;               //!< The TCP segment size, used to count the segments of the sent packets
 
 
   int64_t lastInvScheduled;
@@ -254,7 +573,6 @@ protected:
 
 
   // every 30 seconds
-  const std::vector<double> transactionRates = {9, 2.66, 7, 2.033, 14, 14, 3.6, 2.45, 2.067, 9, 2.067};
 
 };
 
@@ -0,0 +1,119 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-peer-ranking.h
+ */
+
+#include <algorithm>
+#include "bitcoin-peer-ranking.h"
+
+namespace ns3 {
+
+const size_t PeerRanking::ARITY;
+const uint32_t PeerRanking::ABSENT;
+
+PeerRanking::PeerRanking (void)
+{
+  SetPeers (0);
+}
+
+void
+PeerRanking::SetPeers (uint32_t peers)
+{
+  m_heap.clear();
+  m_positions.assign (peers, ABSENT);
+}
+
+void
+PeerRanking::Place (size_t i, const rankedPeer &p)
+{
+  m_heap[i] = p;
+  m_positions[p.peer] = i;
+}
+
+void
+PeerRanking::SiftUp (size_t i)
+{
+  rankedPeer p = m_heap[i];
+  while (i > 0)
+  {
+    size_t parent = (i - 1) / ARITY;
+    if (!Above (p, m_heap[parent]))
+      break;
+    Place (i, m_heap[parent]);
+    i = parent;
+  }
+  Place (i, p);
+}
+
+void
+PeerRanking::SiftDown (size_t i)
+{
+  rankedPeer p = m_heap[i];
+  while (true)
+  {
+    size_t first = i * ARITY + 1;
+    if (first >= m_heap.size())
+      break;
+
+    size_t best = first;
+    size_t last = std::min (first + ARITY, m_heap.size());
+    for (size_t child = first + 1; child < last; child++)
+    {
+      if (Above (m_heap[child], m_heap[best]))
+        best = child;
+    }
+    if (!Above (m_heap[best], p))
+      break;
+    Place (i, m_heap[best]);
+    i = best;
+  }
+  Place (i, p);
+}
+
+void
+PeerRanking::Insert (uint32_t peer, double score, uint32_t tieBreak)
+{
+  rankedPeer p = {score, tieBreak, peer};
+  m_heap.push_back (p);
+  SiftUp (m_heap.size() - 1);
+}
+
+void
+PeerRanking::Update (uint32_t peer, double score)
+{
+  size_t i = m_positions[peer];
+  double previous = m_heap[i].score;
+  m_heap[i].score = score;
+  if (score > previous)
+    SiftUp (i);
+  else if (score < previous)
+    SiftDown (i);
+}
+
+void
+PeerRanking::Best (size_t count, std::vector<uint32_t> &peers) const
+{
+  // The next best peer is always a child of an output one, so the frontier is a heap of these children
+  auto below = [this] (size_t a, size_t b) { return Above (m_heap[b], m_heap[a]); };
+
+  m_frontier.clear();
+  if (!m_heap.empty())
+    m_frontier.push_back (0);
+
+  while (count > 0 && !m_frontier.empty())
+  {
+    std::pop_heap (m_frontier.begin(), m_frontier.end(), below);
+    size_t i = m_frontier.back();
+    m_frontier.pop_back();
+    peers.push_back (m_heap[i].peer);
+    count--;
+
+    size_t last = std::min (i * ARITY + 1 + ARITY, m_heap.size());
+    for (size_t child = i * ARITY + 1; child < last; child++)
+    {
+      m_frontier.push_back (child);
+      std::push_heap (m_frontier.begin(), m_frontier.end(), below);
+    }
+  }
+}
+
+} // Namespace ns3
@@ -0,0 +1,89 @@
+/**
+ * This file declares the PeerRanking class, which orders the peers of a node by a score.
+ */
+
+#ifndef BITCOIN_PEER_RANKING_H
+#define BITCOIN_PEER_RANKING_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * Some of the peers of a node, numbered 0..k-1 as the slots of the node, ordered by a score.
+ *
+ * The peers are held in a 4-ary max-heap, with the position of each peer in the heap, so changing
+ * the score of a peer moves it in O(log k) and the best peer is at the root. A peer enters with a
+ * random tie-break, which orders the peers of equal scores, such as the peers nobody heard from yet,
+ * differently on each node.
+ */
+class PeerRanking
+{
+public:
+  PeerRanking (void);
+
+  /**
+   * \brief Sets the number of slots, and empties the ranking
+   * \param peers the number of slots, k
+   */
+  void SetPeers (uint32_t peers);
+
+  /**
+   * \brief Adds a peer to the ranking
+   * \param peer the slot of the peer, below k and not in the ranking
+   * \param score the score of the peer, the higher the better
+   * \param tieBreak orders the peers of equal scores, the higher the better
+   */
+  void Insert (uint32_t peer, double score, uint32_t tieBreak);
+
+  /**
+   * \brief Changes the score of a peer of the ranking
+   */
+  void Update (uint32_t peer, double score);
+
+  /**
+   * \return true if the peer is in the ranking
+   */
+  bool Contains (uint32_t peer) const
+  {
+    return peer < m_positions.size() && m_positions[peer] != ABSENT;
+  }
+
+  size_t Size (void) const { return m_heap.size(); }
+
+  /**
+   * \brief Appends the best peers to a vector, from the best down, without reordering the heap
+   * \param count the number of peers wanted, all of them if the ranking holds fewer
+   * \param peers the vector to append the slots to
+   */
+  void Best (size_t count, std::vector<uint32_t> &peers) const;
+
+private:
+  typedef struct {
+    double   score;
+    uint32_t tieBreak;
+    uint32_t peer;
+  } rankedPeer;
+
+  static const size_t ARITY = 4;
+  static const uint32_t ABSENT = 0xffffffff;
+
+  static bool Above (const rankedPeer &a, const rankedPeer &b)
+  {
+    return a.score > b.score || (a.score == b.score && a.tieBreak > b.tieBreak);
+  }
+
+  void Place (size_t i, const rankedPeer &p);
+  void SiftUp (size_t i);
+  void SiftDown (size_t i);
+
+  std::vector<rankedPeer>       m_heap;
+  std::vector<uint32_t>         m_positions;    //!< The heap index of each slot, ABSENT for the slots out of the ranking
+  mutable std::vector<size_t>   m_frontier;     //!< The heap indices Best may output next, reused to avoid reallocations
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_PEER_RANKING_H */
@@ -0,0 +1,153 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-peers-know-tx.h
+ */
+
+#include <algorithm>
+#include "bitcoin-peers-know-tx.h"
+
+namespace ns3 {
+
+const int32_t PeersKnowTxTable::EMPTY_KEY;
+
+static const size_t INITIAL_ENTRIES = 16;
+
+PeersKnowTxTable::PeersKnowTxTable (void)
+{
+  SetPeers (0);
+}
+
+void
+PeersKnowTxTable::SetPeers (uint32_t peers)
+{
+  m_peers = peers;
+  m_words = std::max<uint32_t> ((peers + 63) / 64, 1);
+  m_lastWordMask = (peers % 64 == 0) ? ~uint64_t(0) : (uint64_t(1) << (peers % 64)) - 1;
+  m_shift = 28;
+  m_used = 0;
+  m_keys.assign (INITIAL_ENTRIES, EMPTY_KEY);
+  m_bits.assign (INITIAL_ENTRIES * m_words, 0);
+  m_knownByAll = KnownTxSet ();
+}
+
+size_t
+PeersKnowTxTable::Home (int32_t key) const
+{
+  return uint32_t(uint32_t(key) * 2654435769u) >> m_shift;
+}
+
+size_t
+PeersKnowTxTable::FindEntry (int32_t key) const
+{
+  size_t mask = m_keys.size() - 1;
+  size_t i = Home (key);
+
+  while (m_keys[i] != key && m_keys[i] != EMPTY_KEY)
+    i = (i + 1) & mask;
+  return i;
+}
+
+bool
+PeersKnowTxTable::Knows (int txId, uint32_t peer) const
+{
+  if (peer >= m_peers)
+    return false;
+
+  size_t i = FindEntry (txId);
+  if (m_keys[i] == EMPTY_KEY)
+    return m_knownByAll.Contains (txId);
+  return (m_bits[i * m_words + peer / 64] >> (peer % 64)) & 1;
+}
+
+void
+PeersKnowTxTable::Add (int txId, uint32_t peer)
+{
+  if (peer >= m_peers)
+    return;
+
+  size_t i = FindEntry (txId);
+  if (m_keys[i] == EMPTY_KEY)
+  {
+    if (m_knownByAll.Contains (txId))
+      return;
+    if (2 * (m_used + 1) > m_keys.size())
+    {
+      Grow ();
+      i = FindEntry (txId);
+    }
+    m_keys[i] = txId;
+    m_used++;
+  }
+
+  uint64_t *bits = &m_bits[i * m_words];
+  bits[peer / 64] |= uint64_t(1) << (peer % 64);
+
+  for (uint32_t w = 0; w + 1 < m_words; w++)
+  {
+    if (bits[w] != ~uint64_t(0))
+      return;
+  }
+  if (bits[m_words - 1] != m_lastWordMask)
+    return;
+
+  m_knownByAll.Insert (txId);
+  Erase (i);
+}
+
+void
+PeersKnowTxTable::Erase (size_t i)
+{
+  size_t mask = m_keys.size() - 1;
+  size_t j = i;
+
+  while (true)
+  {
+    j = (j + 1) & mask;
+    if (m_keys[j] == EMPTY_KEY)
+      break;
+
+    // The entry at j may fill the hole at i unless its home lies cyclically in (i, j]
+    size_t home = Home (m_keys[j]);
+    bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+    if (stays)
+      continue;
+
+    m_keys[i] = m_keys[j];
+    std::copy (m_bits.begin() + j * m_words, m_bits.begin() + (j + 1) * m_words, m_bits.begin() + i * m_words);
+    i = j;
+  }
+
+  m_keys[i] = EMPTY_KEY;
+  std::fill (m_bits.begin() + i * m_words, m_bits.begin() + (i + 1) * m_words, 0);
+  m_used--;
+}
+
+void
+PeersKnowTxTable::Grow (void)
+{
+  std::vector<int32_t> oldKeys;
+  std::vector<uint64_t> oldBits;
+
+  oldKeys.swap (m_keys);
+  oldBits.swap (m_bits);
+  m_keys.assign (2 * oldKeys.size(), EMPTY_KEY);
+  m_bits.assign (2 * oldBits.size(), 0);
+  m_shift--;
+
+  for (size_t j = 0; j < oldKeys.size(); j++)
+  {
+    if (oldKeys[j] == EMPTY_KEY)
+      continue;
+    size_t i = FindEntry (oldKeys[j]);
+    m_keys[i] = oldKeys[j];
+    std::copy (oldBits.begin() + j * m_words, oldBits.begin() + (j + 1) * m_words, m_bits.begin() + i * m_words);
+  }
+}
+
+size_t
+PeersKnowTxTable::GetMemoryUsage (void) const
+{
+  return sizeof (*this) - sizeof (m_knownByAll) + m_knownByAll.GetMemoryUsage ()
+         + m_keys.capacity() * sizeof (int32_t) + m_bits.capacity() * sizeof (uint64_t);
+}
+
+} // Namespace ns3
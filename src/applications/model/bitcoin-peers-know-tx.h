@@ -0,0 +1,88 @@
+/**
+ * This file declares the PeersKnowTxTable class, which records the peers that know each transaction.
+ */
+
+#ifndef BITCOIN_PEERS_KNOW_TX_H
+#define BITCOIN_PEERS_KNOW_TX_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitcoin-known-txs.h"
+
+namespace ns3 {
+
+/**
+ * Maps transactions to the set of peers which know them, with the peers of the node numbered
+ * 0..k-1. Each transaction takes a key and a bitset of k bits, rounded up to 64 bit words, in an
+ * open-addressing hash table with linear probing, so a check is a single bit test.
+ *
+ * Once every peer knows a transaction, its entry is removed from the table and the transaction
+ * is only remembered in a KnownTxSet, so that the table just holds the transactions which are still
+ * being relayed.
+ */
+class PeersKnowTxTable
+{
+public:
+  PeersKnowTxTable (void);
+
+  /**
+   * \brief Sets the number of peers, and forgets every transaction
+   * \param peers the number of peers, k
+   */
+  void SetPeers (uint32_t peers);
+
+  /**
+   * \param txId the non-negative transaction id
+   * \param peer the number of the peer, below k
+   * \return true if the peer knows the transaction
+   */
+  bool Knows (int txId, uint32_t peer) const;
+
+  /**
+   * \brief Records that a peer knows a transaction
+   * \param txId the non-negative transaction id
+   * \param peer the number of the peer, below k
+   */
+  void Add (int txId, uint32_t peer);
+
+  /**
+   * \return the number of transactions which some but not all peers know
+   */
+  size_t Size (void) const { return m_used; }
+
+  /**
+   * \return the bytes of memory held by the table
+   */
+  size_t GetMemoryUsage (void) const;
+
+private:
+  static const int32_t EMPTY_KEY = -1;
+
+  size_t Home (int32_t key) const;
+
+  /**
+   * \return the entry of the transaction, or the free entry where it belongs
+   */
+  size_t FindEntry (int32_t key) const;
+
+  /**
+   * \brief Removes an entry, and moves the entries after it back to keep the probe sequences intact
+   */
+  void Erase (size_t i);
+
+  void Grow (void);
+
+  std::vector<int32_t>  m_keys;            //!< A power of two entries
+  std::vector<uint64_t> m_bits;            //!< m_words words per entry
+  uint32_t              m_peers;
+  uint32_t              m_words;
+  uint64_t              m_lastWordMask;    //!< The bits of the last word which stand for peers
+  uint32_t              m_shift;           //!< 32 - log2 of the number of entries
+  size_t                m_used;
+  KnownTxSet            m_knownByAll;      //!< The transactions whose entries have been reclaimed
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_PEERS_KNOW_TX_H */
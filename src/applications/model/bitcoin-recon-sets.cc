@@ -0,0 +1,173 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-recon-sets.h
+ */
+
+#include <algorithm>
+#include "bitcoin-recon-sets.h"
+
+namespace ns3 {
+
+static const size_t MIN_COMPACT_SIZE = 64;
+
+ReconciliationSets::ReconciliationSets (void)
+{
+  SetPeers (0);
+}
+
+void
+ReconciliationSets::SetPeers (uint32_t peers)
+{
+  m_words = (peers + 63) / 64;
+  m_entries.clear();
+  m_txs.clear();
+  m_bits.clear();
+  m_refs.clear();
+  m_free.clear();
+  m_lists.assign (peers, std::vector<uint32_t>());
+  m_sizes.assign (peers, 0);
+}
+
+void
+ReconciliationSets::Insert (int txId, const std::vector<uint32_t> &peers)
+{
+  if (peers.empty())
+    return;
+
+  uint32_t entry;
+  auto it = m_entries.find (txId);
+  if (it != m_entries.end())
+    entry = it->second;
+  else
+  {
+    if (!m_free.empty())
+    {
+      entry = m_free.back();
+      m_free.pop_back();
+    }
+    else
+    {
+      entry = m_txs.size();
+      m_txs.push_back (0);
+      m_refs.push_back (0);
+      m_bits.resize (m_bits.size() + m_words, 0);
+    }
+    m_txs[entry] = txId;
+    m_entries[txId] = entry;
+  }
+
+  for (uint32_t peer: peers)
+  {
+    if (IsMember (entry, peer))
+      continue;
+    m_bits[entry * m_words + peer / 64] |= uint64_t(1) << (peer % 64);
+    m_refs[entry]++;
+    m_sizes[peer]++;
+    m_lists[peer].push_back (entry);
+  }
+}
+
+void
+ReconciliationSets::ClearMember (uint32_t entry, uint32_t peer)
+{
+  m_bits[entry * m_words + peer / 64] &= ~(uint64_t(1) << (peer % 64));
+  m_sizes[peer]--;
+  if (--m_refs[entry] == 0)
+  {
+    m_entries.erase (m_txs[entry]);
+    m_free.push_back (entry);
+  }
+}
+
+void
+ReconciliationSets::Remove (int txId, uint32_t peer)
+{
+  auto it = m_entries.find (txId);
+  if (it == m_entries.end() || !IsMember (it->second, peer))
+    return;
+
+  ClearMember (it->second, peer);
+  if (m_lists[peer].size() > 2 * m_sizes[peer] + MIN_COMPACT_SIZE)
+    Compact (peer);
+}
+
+bool
+ReconciliationSets::Contains (int txId, uint32_t peer) const
+{
+  auto it = m_entries.find (txId);
+  return it != m_entries.end() && IsMember (it->second, peer);
+}
+
+void
+ReconciliationSets::Take (uint32_t peer, std::vector<int> &txs)
+{
+  // A list may hold an entry twice, if it was removed and reused, so the bit is cleared on the first one
+  for (uint32_t entry: m_lists[peer])
+  {
+    if (!IsMember (entry, peer))
+      continue;
+    txs.push_back (m_txs[entry]);
+    ClearMember (entry, peer);
+  }
+  m_lists[peer].clear();
+}
+
+void
+ReconciliationSets::Compact (uint32_t peer)
+{
+  std::vector<uint32_t> &list = m_lists[peer];
+  size_t kept = 0;
+
+  // Clear the bits of the kept entries on the way, to keep each of them once, then set them back
+  for (uint32_t entry: list)
+  {
+    if (!IsMember (entry, peer))
+      continue;
+    m_bits[entry * m_words + peer / 64] &= ~(uint64_t(1) << (peer % 64));
+    list[kept++] = entry;
+  }
+  list.resize (kept);
+  for (uint32_t entry: list)
+    m_bits[entry * m_words + peer / 64] |= uint64_t(1) << (peer % 64);
+}
+
+size_t
+ReconciliationSets::GetMemoryUsage (void) const
+{
+  size_t bytes = sizeof (*this) + m_txs.capacity() * sizeof (int) + m_bits.capacity() * sizeof (uint64_t)
+                 + m_refs.capacity() * sizeof (uint32_t) + m_free.capacity() * sizeof (uint32_t)
+                 + m_sizes.capacity() * sizeof (size_t)
+                 + m_entries.bucket_count() * sizeof (void*)
+                 + m_entries.size() * (sizeof (void*) + sizeof (std::pair<const int, uint32_t>) + sizeof (size_t));
+
+  for (const std::vector<uint32_t> &list: m_lists)
+    bytes += sizeof (list) + list.capacity() * sizeof (uint32_t);
+  return bytes;
+}
+
+void
+ReconciliationSets::Difference (const std::vector<int> &mine, const std::vector<int> &his,
+                                std::vector<int> &iMiss, std::vector<int> &heMisses)
+{
+  iMiss.resize (his.size());
+  heMisses.resize (mine.size());
+
+  size_t i = 0, j = 0, a = 0, b = 0;
+  while (i < mine.size() && j < his.size())
+  {
+    int x = mine[i];
+    int y = his[j];
+    heMisses[b] = x;
+    iMiss[a] = y;
+    b += x < y;
+    a += y < x;
+    i += x <= y;
+    j += y <= x;
+  }
+
+  a = std::copy (his.begin() + j, his.end(), iMiss.begin() + a) - iMiss.begin();
+  b = std::copy (mine.begin() + i, mine.end(), heMisses.begin() + b) - heMisses.begin();
+  iMiss.resize (a);
+  heMisses.resize (b);
+}
+
+} // Namespace ns3
@@ -0,0 +1,110 @@
+/**
+ * This file declares the ReconciliationSets class, which holds the transactions to reconcile with each peer.
+ */
+
+#ifndef BITCOIN_RECON_SETS_H
+#define BITCOIN_RECON_SETS_H
+
+#include <vector>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * The reconciliation sets of all peers of a node, with the peers numbered 0..k-1.
+ *
+ * A transaction enters the sets of most peers at once, so it takes a single entry of a shared
+ * pool, with a bitset of the peers whose set holds it. Each peer keeps the list of its entries.
+ * Removing a transaction from the set of a peer only clears its bit and leaves the entry in the
+ * list, where it is skipped when the set is taken, so insertions and removals are O(1). The entry
+ * returns to the pool once no set holds it.
+ */
+class ReconciliationSets
+{
+public:
+  ReconciliationSets (void);
+
+  /**
+   * \brief Sets the number of peers, and empties every set
+   * \param peers the number of peers, k
+   */
+  void SetPeers (uint32_t peers);
+
+  /**
+   * \brief Adds a transaction to the sets of some peers
+   * \param txId the transaction id
+   * \param peers the numbers of the peers, below k
+   */
+  void Insert (int txId, const std::vector<uint32_t> &peers);
+
+  /**
+   * \brief Removes a transaction from the set of a peer, if it is there
+   * \param txId the transaction id
+   * \param peer the number of the peer, below k
+   */
+  void Remove (int txId, uint32_t peer);
+
+  /**
+   * \return true if the set of the peer holds the transaction
+   */
+  bool Contains (int txId, uint32_t peer) const;
+
+  /**
+   * \return the number of transactions in the set of a peer
+   */
+  size_t Size (uint32_t peer) const { return m_sizes[peer]; }
+
+  /**
+   * \brief Appends the set of a peer to txs, in no particular order, and empties it
+   * \param peer the number of the peer, below k
+   * \param txs the vector to append the transactions to
+   */
+  void Take (uint32_t peer, std::vector<int> &txs);
+
+  /**
+   * \return the bytes of memory held by the sets, counting a node of the index per entry
+   */
+  size_t GetMemoryUsage (void) const;
+
+  /**
+   * \brief Compares our set for a peer with the set the peer sent, in a single merge
+   *
+   * The merge is branch-free: each step stores the heads of both sets as candidates and advances
+   * the output and input positions by the results of the comparisons.
+   *
+   * \param mine our set, sorted and without duplicates
+   * \param his the set of the peer, sorted and without duplicates
+   * \param iMiss set to the transactions only the peer holds, in increasing order
+   * \param heMisses set to the transactions only we hold, in increasing order
+   */
+  static void Difference (const std::vector<int> &mine, const std::vector<int> &his,
+                          std::vector<int> &iMiss, std::vector<int> &heMisses);
+
+private:
+  bool IsMember (uint32_t entry, uint32_t peer) const
+  {
+    return (m_bits[entry * m_words + peer / 64] >> (peer % 64)) & 1;
+  }
+
+  void ClearMember (uint32_t entry, uint32_t peer);
+
+  /**
+   * \brief Drops the stale entries of a list once they outnumber the members
+   */
+  void Compact (uint32_t peer);
+
+  std::unordered_map<int, uint32_t>    m_entries;      //!< The entry of each transaction in some set
+  std::vector<int>                     m_txs;          //!< The transaction of each entry
+  std::vector<uint64_t>                m_bits;         //!< m_words words per entry, a bit per peer
+  std::vector<uint32_t>                m_refs;         //!< The number of sets which hold each entry
+  std::vector<uint32_t>                m_free;         //!< The entries back in the pool
+  std::vector<std::vector<uint32_t>>   m_lists;        //!< The entries of each peer, with stale ones
+  std::vector<size_t>                  m_sizes;        //!< The size of the set of each peer
+  uint32_t                             m_words;
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_RECON_SETS_H */
@@ -0,0 +1,84 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-rng.h
+ */
+
+#include "ns3/rng-seed-manager.h"
+#include "bitcoin-rng.h"
+
+namespace ns3 {
+
+const uint64_t BitcoinRng::TOPOLOGY_STREAM;
+const uint64_t BitcoinRng::TX_GENERATOR_STREAM;
+const uint64_t BitcoinRng::BLOCK_GENERATOR_STREAM;
+
+static uint64_t
+SplitMix64 (uint64_t &x)
+{
+  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t
+RotateLeft (uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+BitcoinRng::BitcoinRng (void)
+{
+  SetStream (0);
+}
+
+void
+BitcoinRng::SetStream (uint64_t stream)
+{
+  // Mix the seed, the run and the stream, so that neighbouring values give unrelated states
+  uint64_t x = uint64_t(RngSeedManager::GetSeed ());
+  x = SplitMix64 (x) ^ RngSeedManager::GetRun ();
+  x = SplitMix64 (x) ^ stream;
+  for (int i = 0; i < 4; i++)
+    m_state[i] = SplitMix64 (x);
+}
+
+uint64_t
+BitcoinRng::Next (void)
+{
+  uint64_t result = RotateLeft (m_state[1] * 5, 7) * 9;
+  uint64_t t = m_state[1] << 17;
+
+  m_state[2] ^= m_state[0];
+  m_state[3] ^= m_state[1];
+  m_state[1] ^= m_state[2];
+  m_state[0] ^= m_state[3];
+  m_state[2] ^= t;
+  m_state[3] = RotateLeft (m_state[3], 45);
+  return result;
+}
+
+uint32_t
+BitcoinRng::UniformInt (uint32_t n)
+{
+  // Lemire's multiply and shift, rejecting the few values which would bias the result
+  uint64_t m = (Next () >> 32) * n;
+  uint32_t low = uint32_t (m);
+  if (low < n)
+  {
+    uint32_t threshold = -n % n;
+    while (low < threshold)
+    {
+      m = (Next () >> 32) * n;
+      low = uint32_t (m);
+    }
+  }
+  return m >> 32;
+}
+
+double
+BitcoinRng::UniformReal (void)
+{
+  return (Next () >> 11) * (1.0 / 9007199254740992.0);
+}
+
+} // Namespace ns3
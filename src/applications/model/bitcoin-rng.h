@@ -0,0 +1,57 @@
+/**
+ * This file declares the BitcoinRng class, the random number generator of the nodes.
+ */
+
+#ifndef BITCOIN_RNG_H
+#define BITCOIN_RNG_H
+
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * A xoshiro256** generator: 32 Bytes of state and a few cycles per number.
+ *
+ * Each user owns its generator and seeds it with its own stream number (the node id for the nodes),
+ * mixed with the seed and run number of RngSeedManager, which default-test.cc sets from --seed and
+ * --run. The numbers a node draws thus do not depend on the order in which the nodes run, and the
+ * same seed and run give the same simulation on every MPI rank and on every execution.
+ */
+class BitcoinRng
+{
+public:
+  BitcoinRng (void);
+
+  /**
+   * \brief Seeds the generator from RngSeedManager and a stream number
+   * \param stream the stream number, unique to the user of the generator
+   */
+  void SetStream (uint64_t stream);
+
+  /**
+   * \return the next 64 random bits
+   */
+  uint64_t Next (void);
+
+  /**
+   * \param n the number of values, above 0
+   * \return a uniform integer in [0, n)
+   */
+  uint32_t UniformInt (uint32_t n);
+
+  /**
+   * \return a uniform double in [0, 1)
+   */
+  double UniformReal (void);
+
+  static const uint64_t TOPOLOGY_STREAM = 0xffffffffffffffffULL;        //!< The stream of BitcoinTopologyHelper
+  static const uint64_t TX_GENERATOR_STREAM = 0xfffffffffffffffeULL;    //!< The stream of BitcoinTxGenerator
+  static const uint64_t BLOCK_GENERATOR_STREAM = 0xfffffffffffffffdULL; //!< The stream of BitcoinBlockGenerator
+
+private:
+  uint64_t m_state[4];
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_RNG_H */
@@ -0,0 +1,289 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-sketch.h
+ */
+
+#include <algorithm>
+#include "bitcoin-sketch.h"
+
+namespace ns3 {
+
+/**
+ * GF(2^32) arithmetic, modulo the irreducible polynomial x^32 + x^7 + x^3 + x^2 + 1
+ */
+static uint32_t
+GfMul (uint32_t a, uint32_t b)
+{
+  uint64_t product = 0;
+  uint64_t shifted = a;
+
+  while (b)
+  {
+    if (b & 1)
+      product ^= shifted;
+    shifted <<= 1;
+    b >>= 1;
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    uint64_t high = product >> 32;
+    product = (product & 0xffffffff) ^ high ^ (high << 2) ^ (high << 3) ^ (high << 7);
+  }
+  return uint32_t(product);
+}
+
+static uint32_t
+GfInv (uint32_t a)
+{
+  // a^(2^32 - 2) = a^2 * a^4 * ... * a^(2^31)
+  uint32_t result = 1;
+  for (int i = 1; i < 32; i++)
+  {
+    a = GfMul (a, a);
+    result = GfMul (result, a);
+  }
+  return result;
+}
+
+
+/**
+ * Polynomials over GF(2^32), with the coefficients stored from the lowest degree
+ * and without leading zeros
+ */
+typedef std::vector<uint32_t> Poly;
+
+static void
+PolyTrim (Poly &a)
+{
+  while (!a.empty() && a.back() == 0)
+    a.pop_back();
+}
+
+static void
+PolyMakeMonic (Poly &a)
+{
+  uint32_t inverse = GfInv (a.back());
+  for (uint32_t &coefficient: a)
+    coefficient = GfMul (coefficient, inverse);
+}
+
+/**
+ * Reduces a modulo the monic polynomial m, and stores the quotient if asked to
+ */
+static void
+PolyMod (Poly &a, const Poly &m, Poly *quotient = 0)
+{
+  size_t degree = m.size() - 1;
+
+  if (quotient)
+    quotient->assign (a.size() >= m.size() ? a.size() - degree : 0, 0);
+
+  for (size_t i = a.size(); i-- > degree; )
+  {
+    uint32_t factor = a[i];
+    if (factor == 0)
+      continue;
+    if (quotient)
+      (*quotient)[i - degree] = factor;
+    for (size_t j = 0; j <= degree; j++)
+      a[i - degree + j] ^= GfMul (factor, m[j]);
+  }
+  PolyTrim (a);
+}
+
+static Poly
+PolySqrMod (const Poly &a, const Poly &m)
+{
+  Poly result (a.empty() ? 0 : 2 * a.size() - 1, 0);
+
+  // Squaring is linear in characteristic 2
+  for (size_t i = 0; i < a.size(); i++)
+    result[2 * i] = GfMul (a[i], a[i]);
+  PolyMod (result, m);
+  return result;
+}
+
+static Poly
+PolyGcd (Poly a, Poly b)
+{
+  while (!b.empty())
+  {
+    PolyMakeMonic (b);
+    PolyMod (a, b);
+    std::swap (a, b);
+  }
+  if (!a.empty())
+    PolyMakeMonic (a);
+  return a;
+}
+
+/**
+ * Collects the roots of a monic polynomial which splits into distinct linear factors,
+ * by separating the roots of trace 0 and 1 of beta * x for varying beta
+ */
+static bool
+PolyFindRoots (const Poly &f, std::vector<uint32_t> &roots, uint32_t seed)
+{
+  if (f.size() == 2)
+  {
+    roots.push_back(f[0]);
+    return true;
+  }
+
+  uint32_t beta = seed;
+  for (int attempt = 0; attempt < 64; attempt++)
+  {
+    beta = GfMul (beta, 0x9e3779b9) ^ (attempt + 1);
+
+    Poly y (2, 0);
+    y[1] = beta;
+    PolyMod (y, f);
+    Poly trace = y;
+    for (int i = 1; i < 32; i++)
+    {
+      y = PolySqrMod (y, f);
+      trace.resize (std::max (trace.size(), y.size()), 0);
+      for (size_t j = 0; j < y.size(); j++)
+        trace[j] ^= y[j];
+    }
+    PolyTrim (trace);
+
+    Poly factor = PolyGcd (f, trace);
+    if (factor.size() <= 1 || factor.size() == f.size())
+      continue;
+
+    Poly rest = f;
+    Poly quotient;
+    PolyMod (rest, factor, &quotient);
+    return PolyFindRoots (factor, roots, beta) && PolyFindRoots (quotient, roots, beta);
+  }
+  return false;
+}
+
+
+BitcoinSketch::BitcoinSketch (uint32_t capacity) : m_syndromes (capacity, 0)
+{
+}
+
+BitcoinSketch::BitcoinSketch (const std::vector<uint32_t> &syndromes) : m_syndromes (syndromes)
+{
+}
+
+void
+BitcoinSketch::Add (uint32_t element)
+{
+  uint32_t square = GfMul (element, element);
+  uint32_t power = element;
+
+  for (uint32_t &syndrome: m_syndromes)
+  {
+    syndrome ^= power;
+    power = GfMul (power, square);
+  }
+}
+
+void
+BitcoinSketch::Merge (const BitcoinSketch &other)
+{
+  for (size_t i = 0; i < m_syndromes.size() && i < other.m_syndromes.size(); i++)
+    m_syndromes[i] ^= other.m_syndromes[i];
+}
+
+bool
+BitcoinSketch::Decode (std::vector<uint32_t> &elements) const
+{
+  size_t capacity = m_syndromes.size();
+  elements.clear();
+
+  if (capacity == 0)
+    return false;
+
+  /**
+   * Expand the odd power sums to all 2c power sums: s(2k) = s(k)^2
+   */
+  std::vector<uint32_t> sums (2 * capacity);
+  for (size_t i = 0; i < sums.size(); i++)
+    sums[i] = (i % 2 == 0) ? m_syndromes[i / 2] : GfMul (sums[i / 2], sums[i / 2]);
+
+  /**
+   * Berlekamp-Massey, which finds the connection polynomial of the power sums. Its roots are
+   * the inverses of the elements.
+   */
+  Poly connection (1, 1), previous (1, 1);
+  size_t length = 0, shift = 1;
+  uint32_t previousDiscrepancy = 1;
+
+  for (size_t n = 0; n < sums.size(); n++)
+  {
+    uint32_t discrepancy = sums[n];
+    for (size_t i = 1; i <= length && i < connection.size(); i++)
+      discrepancy ^= GfMul (connection[i], sums[n - i]);
+
+    if (discrepancy == 0)
+    {
+      shift++;
+      continue;
+    }
+
+    uint32_t factor = GfMul (discrepancy, GfInv (previousDiscrepancy));
+    Poly updated = connection;
+    updated.resize (std::max (updated.size(), previous.size() + shift), 0);
+    for (size_t i = 0; i < previous.size(); i++)
+      updated[i + shift] ^= GfMul (factor, previous[i]);
+
+    if (2 * length <= n)
+    {
+      previous = connection;
+      length = n + 1 - length;
+      previousDiscrepancy = discrepancy;
+      shift = 1;
+    }
+    else
+      shift++;
+    connection = updated;
+  }
+
+  // Keep a syndrome to spare for the verification
+  if (length >= capacity)
+    return false;
+  if (length == 0)
+    return true;
+
+  connection.resize (length + 1, 0);
+  if (connection[length] == 0)
+    return false;
+
+  // The reversed polynomial is monic and has the elements themselves as roots
+  Poly locator (connection.rbegin(), connection.rend());
+  PolyMakeMonic (locator);
+
+  if (length > 1)
+  {
+    // x^(2^32) = x modulo the locator iff it splits into distinct linear factors
+    Poly y (2, 0);
+    y[1] = 1;
+    PolyMod (y, locator);
+    for (int i = 0; i < 32; i++)
+      y = PolySqrMod (y, locator);
+    if (y.size() != 2 || y[0] != 0 || y[1] != 1)
+      return false;
+  }
+
+  if (!PolyFindRoots (locator, elements, 1) || elements.size() != length)
+  {
+    elements.clear();
+    return false;
+  }
+
+  BitcoinSketch check (capacity);
+  for (uint32_t element: elements)
+    check.Add (element);
+  if (check.m_syndromes != m_syndromes)
+  {
+    elements.clear();
+    return false;
+  }
+  return true;
+}
+
+} // Namespace ns3
@@ -0,0 +1,82 @@
+/**
+ * This file declares the BitcoinSketch class, a PinSketch (BCH) set sketch over GF(2^32),
+ * which is used to reconcile the transaction sets of two peers.
+ */
+
+#ifndef BITCOIN_SKETCH_H
+#define BITCOIN_SKETCH_H
+
+#include <vector>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * A PinSketch of capacity c holds the odd power sums x, x^3, ..., x^(2c-1) of its elements,
+ * i.e. c syndromes of 32 bits. Adding an element twice removes it, so the sum of the sketches
+ * of two sets is the sketch of their symmetric difference, from which the difference is decoded
+ * with Berlekamp-Massey and a trace-based root finder.
+ *
+ * A sketch of capacity c decodes up to c - 1 elements. The spare syndrome is used to verify
+ * the decoded set, so that a difference larger than the capacity is reported as a failure
+ * instead of being decoded into a wrong set.
+ */
+class BitcoinSketch
+{
+public:
+  /**
+   * \brief Creates an empty sketch
+   * \param capacity the number of syndromes
+   */
+  BitcoinSketch (uint32_t capacity);
+
+  /**
+   * \brief Creates a sketch from received syndromes
+   * \param syndromes the syndromes
+   */
+  BitcoinSketch (const std::vector<uint32_t> &syndromes);
+
+  /**
+   * \brief Adds an element to the sketch, or removes it if it was already added
+   * \param element a non-zero field element
+   */
+  void Add (uint32_t element);
+
+  /**
+   * \brief Adds the elements of another sketch of the same capacity, which leaves the sketch of
+   * the symmetric difference of the two sets
+   * \param other the other sketch
+   */
+  void Merge (const BitcoinSketch &other);
+
+  /**
+   * \brief Decodes the elements of the sketch
+   * \param elements set to the decoded elements
+   * \return false if the sketch holds more elements than it can decode
+   */
+  bool Decode (std::vector<uint32_t> &elements) const;
+
+  uint32_t GetCapacity (void) const { return m_syndromes.size(); }
+  const std::vector<uint32_t>& GetSyndromes (void) const { return m_syndromes; }
+
+  /**
+   * \brief Maps a transaction to its field element
+   * \param txId the transaction
+   * \return the non-zero element representing the transaction
+   */
+  static uint32_t ElementOf (int txId) { return uint32_t(txId) + 1; }
+
+  /**
+   * \brief Maps a decoded field element back to its transaction
+   * \param element the element
+   * \return the transaction
+   */
+  static int TxOf (uint32_t element) { return int(element - 1); }
+
+private:
+  std::vector<uint32_t> m_syndromes;
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_SKETCH_H */
@@ -0,0 +1,45 @@
+/**
+ * This file declares the trace macros used on the hot paths of the bitcoin nodes, i.e. for
+ * every received, decoded or sent message.
+ *
+ * Each macro has a compile-time level. When BITCOIN_TRACE_LEVEL is below it, the macro expands
+ * to a constant false branch and the compiler drops it together with the arguments, so the
+ * message is never built. Otherwise it forwards to NS_LOG, which only streams the arguments
+ * when the log component is enabled at run time. BITCOIN_TRACE_LEVEL defaults to
+ * BITCOIN_TRACE_LEVEL_DEBUG in ns-3 builds with logging and to BITCOIN_TRACE_LEVEL_NONE in
+ * optimized builds, and can be set with -DBITCOIN_TRACE_LEVEL=<level>.
+ */
+
+#ifndef BITCOIN_TRACE_H
+#define BITCOIN_TRACE_H
+
+#include "ns3/log.h"
+
+#define BITCOIN_TRACE_LEVEL_NONE   0
+#define BITCOIN_TRACE_LEVEL_WARN   1
+#define BITCOIN_TRACE_LEVEL_INFO   2
+#define BITCOIN_TRACE_LEVEL_DEBUG  3
+
+#ifndef BITCOIN_TRACE_LEVEL
+#ifdef NS3_LOG_ENABLE
+#define BITCOIN_TRACE_LEVEL BITCOIN_TRACE_LEVEL_DEBUG
+#else
+#define BITCOIN_TRACE_LEVEL BITCOIN_TRACE_LEVEL_NONE
+#endif
+#endif
+
+#define BITCOIN_TRACE(traceLevel, logLevel, msg)        \
+  do                                                    \
+    {                                                   \
+      if (BITCOIN_TRACE_LEVEL >= traceLevel)            \
+        {                                               \
+          NS_LOG (logLevel, msg);                       \
+        }                                               \
+    }                                                   \
+  while (false)
+
+#define BITCOIN_TRACE_WARN(msg)   BITCOIN_TRACE (BITCOIN_TRACE_LEVEL_WARN, ns3::LOG_WARN, msg)
+#define BITCOIN_TRACE_INFO(msg)   BITCOIN_TRACE (BITCOIN_TRACE_LEVEL_INFO, ns3::LOG_INFO, msg)
+#define BITCOIN_TRACE_DEBUG(msg)  BITCOIN_TRACE (BITCOIN_TRACE_LEVEL_DEBUG, ns3::LOG_DEBUG, msg)
+
+#endif /* BITCOIN_TRACE_H */
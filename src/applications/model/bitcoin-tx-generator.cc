@@ -0,0 +1,179 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-tx-generator.h
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "bitcoin-tx-generator.h"
+#include "bitcoin-tx-registry.h"
+#include "bitcoin-node.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BitcoinTxGenerator");
+
+NS_OBJECT_ENSURE_REGISTERED (BitcoinTxGenerator);
+
+TypeId
+BitcoinTxGenerator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BitcoinTxGenerator")
+    .SetParent<Object> ()
+    .SetGroupName("Applications")
+    .AddConstructor<BitcoinTxGenerator> ()
+  ;
+  return tid;
+}
+
+BitcoinTxGenerator::BitcoinTxGenerator (void) : m_period (Seconds (60)), m_arrivals (0), m_transactionSize (522)
+{
+  NS_LOG_FUNCTION (this);
+  m_rng.SetStream (BitcoinRng::TX_GENERATOR_STREAM);
+}
+
+BitcoinTxGenerator::~BitcoinTxGenerator (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BitcoinTxGenerator::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_nextArrival);
+  m_nodes.clear ();
+  Object::DoDispose ();
+}
+
+void
+BitcoinTxGenerator::SetEmitters (const std::vector<uint32_t> &emitters, const std::vector<double> &weights)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (weights.empty () || weights.size () == emitters.size (), "Every emitter needs a weight");
+
+  m_emitters = emitters;
+  m_emitterNumbers.clear ();
+  for (uint32_t i = 0; i < m_emitters.size (); i++)
+    m_emitterNumbers[m_emitters[i]] = i;
+  m_nodes.assign (m_emitters.size (), 0);
+
+  m_cumulativeWeights.clear ();
+  double total = 0;
+  for (double weight: weights)
+  {
+    total += weight;
+    m_cumulativeWeights.push_back (total);
+  }
+
+  BitcoinTxRegistry::Get ().SetEmitters (m_emitters);
+}
+
+void
+BitcoinTxGenerator::SetRates (const std::vector<double> &rates, Time period)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (!rates.empty () && period.IsStrictlyPositive (), "The rate curve needs a rate and a period");
+  m_rates = rates;
+  m_period = period;
+}
+
+void
+BitcoinTxGenerator::SetTransactionSize (uint32_t size)
+{
+  NS_LOG_FUNCTION (this << size);
+  m_transactionSize = size;
+}
+
+void
+BitcoinTxGenerator::Start (Time start, Time stop)
+{
+  NS_LOG_FUNCTION (this << start << stop);
+  m_start = start;
+  m_stop = stop;
+
+  if (m_emitters.empty () || m_rates.empty ())
+    return;
+
+  Time next = NextArrival (start);
+  if (!next.IsNegative () && next <= m_stop)
+    m_nextArrival = Simulator::Schedule (next - Simulator::Now (), &BitcoinTxGenerator::Arrive, this);
+}
+
+void
+BitcoinTxGenerator::Attach (uint32_t nodeId, BitcoinNode *node)
+{
+  auto it = m_emitterNumbers.find (nodeId);
+  if (it != m_emitterNumbers.end ())
+    m_nodes[it->second] = node;
+}
+
+void
+BitcoinTxGenerator::Detach (uint32_t nodeId)
+{
+  auto it = m_emitterNumbers.find (nodeId);
+  if (it != m_emitterNumbers.end ())
+    m_nodes[it->second] = 0;
+}
+
+uint64_t
+BitcoinTxGenerator::GetArrivals (void) const
+{
+  return m_arrivals;
+}
+
+Time
+BitcoinTxGenerator::NextArrival (Time now)
+{
+  // Walk the curve until the integrated rate reaches an exponential draw
+  double t = now.GetSeconds ();
+  double period = m_period.GetSeconds ();
+  double remaining = -log (1 - m_rng.UniformReal ());
+  size_t i = t <= m_start.GetSeconds () ? 0 : size_t ((t - m_start.GetSeconds ()) / period);
+
+  for (; i + 1 < m_rates.size (); i++)
+  {
+    double end = m_start.GetSeconds () + (i + 1) * period;
+    double mass = m_rates[i] * std::max (end - t, 0.0);
+    if (m_rates[i] > 0 && mass >= remaining)
+      return Seconds (t + remaining / m_rates[i]);
+    remaining -= mass;
+    t = std::max (t, end);
+  }
+
+  double rate = m_rates.back ();
+  return rate > 0 ? Seconds (t + remaining / rate) : Seconds (-1);
+}
+
+uint32_t
+BitcoinTxGenerator::ChooseEmitter (void)
+{
+  if (m_cumulativeWeights.empty ())
+    return m_rng.UniformInt (m_emitters.size ());
+
+  double x = m_rng.UniformReal () * m_cumulativeWeights.back ();
+  size_t i = std::upper_bound (m_cumulativeWeights.begin (), m_cumulativeWeights.end (), x) - m_cumulativeWeights.begin ();
+  return std::min (i, m_emitters.size () - 1);
+}
+
+void
+BitcoinTxGenerator::Arrive (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_arrivals++;
+
+  // Every rank draws the same emitter and registers the transaction under the same index, and the
+  // rank which runs the emitter creates it
+  uint32_t emitter = ChooseEmitter ();
+  int txId = BitcoinTxRegistry::Get ().Register (m_emitters[emitter], Simulator::Now ().GetSeconds (), m_transactionSize);
+  BitcoinNode *node = m_nodes[emitter];
+  if (node)
+    node->EmitTransaction (txId);
+
+  Time next = NextArrival (Simulator::Now ());
+  if (!next.IsNegative () && next <= m_stop)
+    m_nextArrival = Simulator::Schedule (next - Simulator::Now (), &BitcoinTxGenerator::Arrive, this);
+}
+
+} // Namespace ns3
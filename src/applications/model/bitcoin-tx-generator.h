@@ -0,0 +1,116 @@
+/**
+ * This file declares the BitcoinTxGenerator class, which creates the transactions of the simulation.
+ */
+
+#ifndef BITCOIN_TX_GENERATOR_H
+#define BITCOIN_TX_GENERATOR_H
+
+#include <vector>
+#include <unordered_map>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "bitcoin-rng.h"
+
+namespace ns3 {
+
+class BitcoinNode;
+
+
+/**
+ * Creates the transactions of the whole network as a single Poisson arrival process, and hands
+ * each one to an emitter chosen uniformly or by weight. Only the arrivals are scheduled, so the
+ * events spent on transaction generation grow with the number of transactions, not with the
+ * number of emitters.
+ *
+ * The arrival rate follows a piecewise constant curve, in transactions per second for the whole
+ * network. The generator draws from its own BitcoinRng stream, so every MPI rank replays the same
+ * arrivals. Every rank registers each arrival with BitcoinTxRegistry, and only the rank of the
+ * chosen emitter creates the transaction.
+ */
+class BitcoinTxGenerator : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+  BitcoinTxGenerator (void);
+  virtual ~BitcoinTxGenerator (void);
+
+  /**
+   * \brief Sets the nodes which create transactions, and registers them with BitcoinTxRegistry
+   * \param emitters the node ids of the emitters, in the same order on every rank
+   * \param weights the relative weight of each emitter, or an empty vector to choose them uniformly
+   */
+  void SetEmitters (const std::vector<uint32_t> &emitters, const std::vector<double> &weights);
+
+  /**
+   * \brief Sets the rate curve
+   * \param rates the transactions per second of the network during each period. The last rate
+   * holds until the end.
+   * \param period the length of each period
+   */
+  void SetRates (const std::vector<double> &rates, Time period);
+
+  /**
+   * \brief Sets the size of the transactions, 522 Bytes by default
+   * \param size the size of every transaction in Bytes
+   */
+  void SetTransactionSize (uint32_t size);
+
+  /**
+   * \brief Schedules the arrivals
+   * \param start the time the rate curve starts at
+   * \param stop the time after which no transaction is created
+   */
+  void Start (Time start, Time stop);
+
+  /**
+   * \brief Lets a node create the transactions of its emitter
+   * \param nodeId the id of the node
+   * \param node the application of the node
+   */
+  void Attach (uint32_t nodeId, BitcoinNode *node);
+
+  /**
+   * \brief Stops handing transactions to a node
+   * \param nodeId the id of the node
+   */
+  void Detach (uint32_t nodeId);
+
+  /**
+   * \return the number of transactions created so far in the whole network
+   */
+  uint64_t GetArrivals (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \return the time of the next arrival after now, or a negative time if the rate stays 0
+   */
+  Time NextArrival (Time now);
+
+  /**
+   * \return the number of an emitter, drawn uniformly or by weight
+   */
+  uint32_t ChooseEmitter (void);
+
+  void Arrive (void);
+
+  std::vector<uint32_t>                     m_emitters;               //!< The node id of each emitter
+  std::vector<double>                       m_cumulativeWeights;      //!< Empty for uniform choices
+  std::unordered_map<uint32_t, uint32_t>    m_emitterNumbers;         //!< The number of each emitter by node id
+  std::vector<BitcoinNode*>                 m_nodes;                  //!< The attached node of each emitter, 0 on other ranks
+  std::vector<double>                       m_rates;                  //!< Transactions per second during each period
+  Time                                      m_period;
+  Time                                      m_start;
+  Time                                      m_stop;
+  BitcoinRng                                m_rng;
+  EventId                                   m_nextArrival;
+  uint64_t                                  m_arrivals;
+  uint32_t                                  m_transactionSize;        //!< In Bytes
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_TX_GENERATOR_H */
@@ -0,0 +1,76 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-tx-registry.h
+ */
+
+#include <limits>
+#include "ns3/fatal-error.h"
+#include "bitcoin-tx-registry.h"
+
+namespace ns3 {
+
+BitcoinTxRegistry::BitcoinTxRegistry (void)
+{
+}
+
+BitcoinTxRegistry &
+BitcoinTxRegistry::Get (void)
+{
+  static BitcoinTxRegistry registry;
+  return registry;
+}
+
+void
+BitcoinTxRegistry::SetEmitters (const std::vector<uint32_t> &emitters)
+{
+  m_emitterNumbers.clear();
+  for (uint32_t i = 0; i < emitters.size(); i++)
+  {
+    if (emitters[i] >= m_emitterNumbers.size())
+      m_emitterNumbers.resize(emitters[i] + 1, -1);
+    m_emitterNumbers[emitters[i]] = i;
+  }
+  m_created.assign (emitters.size(), 0);
+  m_metadata.clear();
+}
+
+int
+BitcoinTxRegistry::Register (uint32_t origin, double creationTime, uint32_t size)
+{
+  if (origin >= m_emitterNumbers.size() || m_emitterNumbers[origin] < 0)
+    NS_FATAL_ERROR ("Node " << origin << " is not a registered transaction emitter");
+  if (m_metadata.size() > size_t(std::numeric_limits<int>::max()))
+    NS_FATAL_ERROR ("Too many transactions to index");
+
+  uint32_t emitter = m_emitterNumbers[origin];
+  m_created[emitter]++;
+
+  txMetadata metadata = {origin, m_created[emitter], creationTime, size};
+  m_metadata.push_back (metadata);
+  return m_metadata.size() - 1;
+}
+
+uint64_t
+BitcoinTxRegistry::GetId (int txIndex) const
+{
+  return uint64_t(m_metadata[txIndex].origin) << 32 | m_metadata[txIndex].sequence;
+}
+
+uint32_t
+BitcoinTxRegistry::GetOrigin (int txIndex) const
+{
+  return m_metadata[txIndex].origin;
+}
+
+double
+BitcoinTxRegistry::GetCreationTime (int txIndex) const
+{
+  return m_metadata[txIndex].creationTime;
+}
+
+uint32_t
+BitcoinTxRegistry::GetSize (int txIndex) const
+{
+  return m_metadata[txIndex].size;
+}
+
+} // Namespace ns3
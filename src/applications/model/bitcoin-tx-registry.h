@@ -0,0 +1,94 @@
+/**
+ * This file declares the BitcoinTxRegistry class, which numbers the transactions of the simulation.
+ */
+
+#ifndef BITCOIN_TX_REGISTRY_H
+#define BITCOIN_TX_REGISTRY_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * The simulation-wide registry of transactions.
+ *
+ * A transaction is identified by a 64 bit id, origin << 32 | sequence number, where the sequence
+ * numbers of each origin start from 1. Nodes, messages and statistics refer to it by its index, a
+ * dense non-negative int, which is also the id carried on the wire: the 64 bit id is only derived
+ * for the traces.
+ *
+ * The index is the number of the transaction among all the transactions of the network, in the order
+ * of creation. BitcoinTxGenerator replays the same arrivals on every MPI rank and registers each
+ * of them on every rank, so every rank derives the same index for a transaction without any
+ * communication. The indices are 0..n-1 whatever the rates of the emitters, so a skewed choice of
+ * emitters leaves no gaps, and two transactions never share an index since each registration
+ * takes the next one.
+ *
+ * The origin, the creation time and the size of a transaction are stored once here, on every rank.
+ */
+class BitcoinTxRegistry
+{
+public:
+  /**
+   * \return the registry of this process
+   */
+  static BitcoinTxRegistry &Get (void);
+
+  /**
+   * \brief Sets the nodes which create transactions, and forgets every transaction
+   * \param emitters the node ids of the emitters, in the same order on every rank
+   */
+  void SetEmitters (const std::vector<uint32_t> &emitters);
+
+  /**
+   * \brief Registers a new transaction. Every rank registers the transactions of the whole network,
+   * in the same order.
+   * \param origin the node id of an emitter
+   * \param creationTime the creation time in seconds
+   * \param size the size of the transaction in Bytes
+   * \return the index of the transaction
+   */
+  int Register (uint32_t origin, double creationTime, uint32_t size);
+
+  /**
+   * \return the 64 bit id of a transaction
+   */
+  uint64_t GetId (int txIndex) const;
+
+  uint32_t GetOrigin (int txIndex) const;
+
+  /**
+   * \return the creation time of a transaction in seconds
+   */
+  double GetCreationTime (int txIndex) const;
+
+  /**
+   * \return the size of a transaction in Bytes
+   */
+  uint32_t GetSize (int txIndex) const;
+
+  /**
+   * \return the number of transactions created in the network
+   */
+  size_t GetRegistered (void) const { return m_metadata.size(); }
+
+private:
+  BitcoinTxRegistry (void);
+
+  typedef struct {
+    uint32_t origin;
+    uint32_t sequence;
+    double   creationTime;
+    uint32_t size;
+  } txMetadata;
+
+  std::vector<int32_t>     m_emitterNumbers;    //!< The number of each node among the emitters, -1 for the others
+  std::vector<uint32_t>    m_created;           //!< The transactions created by each emitter
+  std::vector<txMetadata>  m_metadata;          //!< By transaction index
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_TX_REGISTRY_H */
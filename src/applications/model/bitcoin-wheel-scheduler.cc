@@ -0,0 +1,216 @@
+/**
+ * This file contains the definitions of the functions declared in bitcoin-wheel-scheduler.h
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "bitcoin-wheel-scheduler.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("WheelScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (WheelScheduler);
+
+const uint32_t WheelScheduler::SLOT_SHIFT;
+const uint32_t WheelScheduler::WHEEL_SHIFT;
+const uint64_t WheelScheduler::WHEEL_SLOTS;
+
+/**
+ * The order of the heaps: an event comes after the events with earlier timestamps, or with the same one and lower uids
+ */
+static bool
+Later (const Scheduler::Event &a, const Scheduler::Event &b)
+{
+  return a.key.m_ts > b.key.m_ts || (a.key.m_ts == b.key.m_ts && a.key.m_uid > b.key.m_uid);
+}
+
+static bool
+RemoveFrom (std::vector<Scheduler::Event> &events, const Scheduler::Event &ev)
+{
+  for (size_t i = 0; i < events.size (); i++)
+  {
+    if (events[i].key.m_uid == ev.key.m_uid && events[i].key.m_ts == ev.key.m_ts)
+    {
+      events[i] = events.back ();
+      events.pop_back ();
+      return true;
+    }
+  }
+  return false;
+}
+
+TypeId
+WheelScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::WheelScheduler")
+    .SetParent<Scheduler> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<WheelScheduler> ()
+  ;
+  return tid;
+}
+
+WheelScheduler::WheelScheduler (void)
+  : m_wheel (WHEEL_SLOTS), m_occupied (WHEEL_SLOTS / 64, 0), m_slot (0), m_wheelEvents (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+WheelScheduler::~WheelScheduler (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+WheelScheduler::Insert (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  uint64_t slot = ev.key.m_ts >> SLOT_SHIFT;
+
+  if (slot <= m_slot)
+  {
+    m_current.push_back (ev);
+    std::push_heap (m_current.begin (), m_current.end (), Later);
+    return;
+  }
+
+  if (slot - m_slot < WHEEL_SLOTS)
+  {
+    uint64_t i = slot & (WHEEL_SLOTS - 1);
+    m_wheel[i].push_back (ev);
+    m_occupied[i / 64] |= uint64_t(1) << (i % 64);
+    m_wheelEvents++;
+  }
+  else
+  {
+    m_overflow.push_back (ev);
+    std::push_heap (m_overflow.begin (), m_overflow.end (), Later);
+  }
+
+  if (m_current.empty ())
+    Advance ();
+}
+
+bool
+WheelScheduler::IsEmpty (void) const
+{
+  // The heap of the current slot only runs dry when the wheel and the overflow are empty too
+  return m_current.empty ();
+}
+
+Scheduler::Event
+WheelScheduler::PeekNext (void) const
+{
+  NS_ASSERT (!IsEmpty ());
+  return m_current.front ();
+}
+
+Scheduler::Event
+WheelScheduler::RemoveNext (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+
+  std::pop_heap (m_current.begin (), m_current.end (), Later);
+  Event ev = m_current.back ();
+  m_current.pop_back ();
+
+  if (m_current.empty ())
+    Advance ();
+  return ev;
+}
+
+void
+WheelScheduler::Remove (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  uint64_t slot = ev.key.m_ts >> SLOT_SHIFT;
+
+  if (slot <= m_slot)
+  {
+    RemoveFrom (m_current, ev);
+    std::make_heap (m_current.begin (), m_current.end (), Later);
+  }
+  else if (slot - m_slot < WHEEL_SLOTS)
+  {
+    uint64_t i = slot & (WHEEL_SLOTS - 1);
+    if (RemoveFrom (m_wheel[i], ev))
+      m_wheelEvents--;
+    if (m_wheel[i].empty ())
+      m_occupied[i / 64] &= ~(uint64_t(1) << (i % 64));
+  }
+  else
+  {
+    RemoveFrom (m_overflow, ev);
+    std::make_heap (m_overflow.begin (), m_overflow.end (), Later);
+  }
+
+  if (m_current.empty ())
+    Advance ();
+}
+
+uint64_t
+WheelScheduler::FindNextSlot (void) const
+{
+  if (m_wheelEvents == 0)
+    return 0;
+
+  uint64_t start = (m_slot + 1) & (WHEEL_SLOTS - 1);
+  uint64_t scanned = 0;
+  while (scanned < WHEEL_SLOTS)
+  {
+    uint64_t i = (start + scanned) & (WHEEL_SLOTS - 1);
+    uint64_t word = m_occupied[i / 64] >> (i % 64);
+    if (word)
+      return scanned + 1 + __builtin_ctzll (word);
+    scanned += 64 - i % 64;
+  }
+  NS_ASSERT_MSG (false, "The wheel holds events but no slot is marked");
+  return 0;
+}
+
+void
+WheelScheduler::Advance (void)
+{
+  uint64_t distance = FindNextSlot ();
+  if (distance == 0 && m_overflow.empty ())
+    return;
+
+  uint64_t next = distance ? m_slot + distance : m_overflow.front ().key.m_ts >> SLOT_SHIFT;
+  if (!m_overflow.empty ())
+    next = std::min (next, m_overflow.front ().key.m_ts >> SLOT_SHIFT);
+  m_slot = next;
+
+  uint64_t i = next & (WHEEL_SLOTS - 1);
+  if (m_occupied[i / 64] & (uint64_t(1) << (i % 64)))
+  {
+    m_current.swap (m_wheel[i]);
+    m_occupied[i / 64] &= ~(uint64_t(1) << (i % 64));
+    m_wheelEvents -= m_current.size ();
+  }
+
+  // The overflow events which the wheel now covers move into it
+  while (!m_overflow.empty () && (m_overflow.front ().key.m_ts >> SLOT_SHIFT) - m_slot < WHEEL_SLOTS)
+  {
+    std::pop_heap (m_overflow.begin (), m_overflow.end (), Later);
+    Event ev = m_overflow.back ();
+    m_overflow.pop_back ();
+
+    uint64_t slot = ev.key.m_ts >> SLOT_SHIFT;
+    if (slot == m_slot)
+      m_current.push_back (ev);
+    else
+    {
+      uint64_t j = slot & (WHEEL_SLOTS - 1);
+      m_wheel[j].push_back (ev);
+      m_occupied[j / 64] |= uint64_t(1) << (j % 64);
+      m_wheelEvents++;
+    }
+  }
+
+  std::make_heap (m_current.begin (), m_current.end (), Later);
+}
+
+} // Namespace ns3
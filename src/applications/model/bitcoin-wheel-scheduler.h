@@ -0,0 +1,65 @@
+/**
+ * This file declares the WheelScheduler class, a timing wheel event scheduler for the bitcoin nodes.
+ */
+
+#ifndef BITCOIN_WHEEL_SCHEDULER_H
+#define BITCOIN_WHEEL_SCHEDULER_H
+
+#include <vector>
+#include "ns3/scheduler.h"
+
+namespace ns3 {
+
+/**
+ * An ns-3 Scheduler which files the events in a timing wheel of 2^16 slots of 2^20 ns (about 1 ms),
+ * so about 68 s ahead of the current slot.
+ *
+ * Most events of a run are INVs, GETDATAs and reconciliations delayed by PoissonNextSend or by link
+ * latencies, a few seconds ahead at most, so an insertion is an append to the vector of a slot. The
+ * events of the current slot go to a small binary heap once the wheel reaches the slot, and a bitmap
+ * of the non-empty slots lets the wheel skip the empty ones 64 at a time. The events beyond the
+ * wheel wait in a heap until the wheel comes close enough.
+ *
+ * Events run in the order of their timestamps and uids, as with the other schedulers. Select it
+ * with GlobalValue::Bind ("SchedulerType", StringValue ("ns3::WheelScheduler")).
+ */
+class WheelScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  WheelScheduler (void);
+  virtual ~WheelScheduler (void);
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  static const uint32_t SLOT_SHIFT = 20;                 //!< log2 of the slot width in time steps
+  static const uint32_t WHEEL_SHIFT = 16;                //!< log2 of the number of slots
+  static const uint64_t WHEEL_SLOTS = uint64_t(1) << WHEEL_SHIFT;
+
+  /**
+   * \brief Moves the wheel to the next slot with events, and fills the heap of the current slot with them
+   */
+  void Advance (void);
+
+  /**
+   * \return the distance from the current slot to the next non-empty slot of the wheel, or 0 if there is none
+   */
+  uint64_t FindNextSlot (void) const;
+
+  std::vector<std::vector<Event>>   m_wheel;
+  std::vector<uint64_t>             m_occupied;          //!< A bit per slot of the wheel
+  std::vector<Event>                m_current;           //!< A min-heap of the events up to the current slot
+  std::vector<Event>                m_overflow;          //!< A min-heap of the events beyond the wheel
+  uint64_t                          m_slot;              //!< The current slot, in slot widths since the start
+  size_t                            m_wheelEvents;       //!< The events in the wheel
+};
+
+} // namespace ns3
+
+#endif /* BITCOIN_WHEEL_SCHEDULER_H */
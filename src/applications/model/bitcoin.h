@@ -25,10 +25,50 @@ const int TX_EMITTERS = 1000;
 
 const int RECON_MAX_SET_SIZE = 1600;
 
+/**
+ * Transactions created and sets reconciled in the last seconds of a run are left out,
+ * since the network has no time to relay them.
+ */
+const int TIME_NOT_TO_COUNT = 20;
+
 const int DANDELION_ROTATION_SECONDS = 1000;
 
+/**
+ * The outbound peers which carry the stems of a node during an epoch, as in Dandelion++
+ */
+const int DANDELION_STEM_PEERS = 2;
+
 const double A_ESTIMATOR = 0.04;
 
+/**
+ * The most syndromes of a reconciliation sketch. Larger differences are found by the bisection
+ * or the fallback, which costs less than decoding a sketch quadratic in its capacity.
+ */
+const int SKETCH_MAX_CAPACITY = 512;
+
+/**
+ * A sketch reconciliation the peer did not close within SKETCH_TIMEOUT_SECONDS is given up, and its
+ * transactions go back to the reconciliation set of the peer. Messages carry no reconciliation id,
+ * so a difference arriving later is taken for the answer to the next sketch.
+ */
+const int SKETCH_TIMEOUT_SECONDS = 30;
+
+/**
+ * With bhInference a node checks the behaviour of its peers every BH_CHECK_SECONDS. A peer is taken
+ * for a black hole once it announced fewer than BH_MIN_INV_RATIO of the transactions we announced
+ * to it, counted after the first BH_MIN_INVS_SENT, or once it left BH_MISSED_RECONCILIATIONS
+ * reconciliations in a row unanswered.
+ */
+const int BH_CHECK_SECONDS = 10;
+const int BH_MIN_INVS_SENT = 100;
+const double BH_MIN_INV_RATIO = 0.02;
+const int BH_MISSED_RECONCILIATIONS = 3;
+
+/**
+ * The most transactions a miner puts in a block, the oldest of its mempool first
+ */
+const int BLOCK_MAX_TXS = 4000;
+
 /**
  * The bitcoin message types that have been implemented.
  */
@@ -42,9 +82,20 @@ enum Messages
   UPDATE_FILTER_BEGIN,
   UPDATE_FILTER_END,
   RECONCILE_TX_REQUEST,
-  RECONCILE_TX_RESPONSE
+  RECONCILE_TX_RESPONSE,
+  RECONCILE_SKETCH,
+  RECONCILE_BISECTION_REQUEST,
+  RECONCILE_BISECTION_SKETCH,
+  RECONCILE_FALLBACK_REQUEST,
+  RECONCILE_DIFF,
+  DANDELION_TX,     //!< A transaction in the stem phase of Dandelion, relayed to a single peer
+  CMPCT_BLOCK,      //!< A block announced by the short ids of its transactions, as in BIP152
+  GET_BLOCK_TXN,    //!< The transactions of a compact block the receiver could not find
+  BLOCK_TXN         //!< The answer to GET_BLOCK_TXN
 };
 
+const int MESSAGE_TYPES = BLOCK_TXN + 1;
+
 enum ProtocolType
 {
   STANDARD_PROTOCOL,           //DEFAULT
@@ -63,6 +114,14 @@ enum ReconcilStrategy
 };
 
 
+enum WireFormat
+{
+  JSON_WIRE,           //DEFAULT
+  BINARY_WIRE,
+  VIRTUAL_WIRE
+};
+
+
 enum ModeType
 {
   REGULAR,           //DEFAULT
@@ -78,14 +137,44 @@ typedef struct {
   int hopNumber;
 } txRecvTime;
 
+typedef struct {
+  int txHash;
+  int hopNumber;
+} invItem;
+
 typedef struct {
   int nodeId;
   int setInSize;
   int setOutSize;
   int diffSize;
   int estimatedDiff;
+  int outcome;          //!< 0 — estimated from the full sets, 1 — sketch decoded, 2 — decoded after bisection, 3 — fallback to the full set
+  int syndromes;        //!< The syndromes actually sent, 0 unless measured
+  int fallbackSize;     //!< The transactions sent in full by the fallback
+  double latency;       //!< Seconds from the first sketch to the decoded difference
 } reconcilItem;
 
+/**
+ * The state of a sketch reconciliation with a peer, kept by both sides until the difference is known.
+ */
+typedef struct {
+  double                startTime;
+  int                   capacity;
+  std::vector<int>      snapshot;      //!< Our reconciliation set for the peer at the start of the exchange
+  std::vector<uint32_t> peerSketch;    //!< The first sketch of the initiator, kept by the responder for the bisection
+  int                   peerSetSize;
+  bool                  bisected;
+  bool                  fellBack;
+} sketchReconcilState;
+
+/**
+ * A compact block waiting for the transactions the node did not know.
+ */
+typedef struct {
+  std::vector<int>      txs;           //!< The transactions of the block
+  uint32_t              fromSlot;      //!< The peer which announced it
+} pendingBlock;
+
 
 
 /**
@@ -106,12 +195,44 @@ typedef struct {
   int systemId;
 
   std::vector<txRecvTime> txReceivedTimes;
-  int ignoredFilters;
+  int ignoredFilters;         //!< INVs received from a peer outside the hash range we requested from it
 
   int reconcils;
   std::vector<reconcilItem> reconcilData;
 
   int mode;
+
+  long rxReadCalls;           //!< HandleRead calls which received data
+  long rxBytesReceived;
+  long rxBytesBuffered;       //!< bytes of incomplete frames left in the receive buffers at the end of each call
+  long rxFramesDecoded;
+
+  long txPackets[MESSAGE_TYPES];     //!< packets handed to the transport, under the type of their first message
+  long txBytes[MESSAGE_TYPES];
+  long txSegments[MESSAGE_TYPES];    //!< TCP segments needed by the packets at the socket's segment size
+
+  long knownTxBytes;          //!< memory held by the index of known transactions when the node stops
+  long peersKnowTxBytes;      //!< memory held by the table of the peers which know each transaction when the node stops
+
+  long invEventsExecuted;     //!< announcements to a peer which were due and sent
+  long invEventsCancelled;    //!< announcements to a peer dropped as the peer learnt the transaction before they were due
+
+  long dandelionStemRelays;   //!< transactions relayed along the stem
+  long dandelionEmbargoFluffs; //!< stem transactions fluffed when their embargo expired
+
+  long filteredInvs;          //!< announcements to a peer which a relay filter left out
+
+  int bhLinks;                //!< peers which are black holes, as their MODE messages tell
+  int bhDetected;             //!< of which the behaviour of the peer gave away
+  int bhFalsePositives;       //!< other peers which were taken for black holes at some point
+  double bhDetectionLatency;  //!< the sum over the detected black holes of the seconds until they were found
+
+  long blocksMined;
+  long blocksReceived;        //!< blocks the node reconstructed, its own ones left out
+  long blockRoundTrips;       //!< compact blocks which needed a GET_BLOCK_TXN
+  long blockTxsMissing;       //!< transactions of compact blocks which were not known
+  double blockLatencySum;     //!< the sum of the seconds between mining and reconstructing each block
+  double blockLatencyMax;
 } nodeStatistics;
 
 typedef struct {
@@ -121,6 +242,11 @@ typedef struct {
   long numGetDataSent;
   double connectionLength;
   double usefulInvRate;
+
+  long numInvSent;                  //!< transactions we announced to the peer
+  long numInvReceived;              //!< transactions the peer announced to us, reconciliations included
+  int numReconcilUnanswered;        //!< reconciliations we started with the peer since its last answer
+  double flaggedAt;                 //!< when the peer was first taken for a black hole, -1 if never
 } peerStatistics;
 
 typedef struct {
@@ -139,11 +265,28 @@ typedef struct {
 
   int reconciliationMode;
   bool bhDetection;
+  bool bhInference;            //!< Find the black holes by their behaviour instead of their MODE messages
   int reconciliationIntervalSeconds;
+  int reconciliationThreshold;          //!< In SET_SIZE_BASED mode, the set size which starts a reconciliation with a peer
+  int reconciliationMaxDelaySeconds;    //!< In SET_SIZE_BASED mode, the longest time between two reconciliations with a peer
   double qEstimationMultiplier;
+  bool sketchReconciliation;   //!< Reconcile with sketches, bisection and fallback instead of shipping the full sets
+
+  WireFormat wireFormat;
+  int invBatchSize;          //!< Max inventories per trickled INV message, 0 sends one INV per transaction
+  int coalesceWindowMs;      //!< The frames sent to a peer within this window share a packet, 0 sends each frame on its own
+  double dandelionFluffProbability;   //!< The probability that a stem relay fluffs the transaction instead
+  double dandelionEmbargoSeconds;     //!< The mean of the exponential embargo timer of a stem transaction
+  double filterOverlap;               //!< The extra share of the hash space each filtered link covers, 0 tiles it exactly
+
 
 } ProtocolSettings;
 
+/**
+ * The relay filters map each transaction to a position in [0, FILTER_BASE_NUMBERING) by its hash.
+ * A filter is the circular range [begin, end) of positions, with begin < FILTER_BASE_NUMBERING and
+ * begin < end <= begin + FILTER_BASE_NUMBERING, the latter for a link without filter.
+ */
 #define FILTER_BASE_NUMBERING 1000
 
 }// Namespace ns3
@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Tests of the relay of compact blocks: a BitcoinNode on the message channel, whose two peers
+ * are played by the test, which sends their messages on the channel and drops what the node sends them.
+ *
+ * ./test.py -s bitcoin-block-relay
+ */
+
+#include <map>
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/node-container.h"
+#include "ns3/application-container.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/bitcoin-node-helper.h"
+#include "ns3/bitcoin-channel.h"
+
+using namespace ns3;
+
+static bitcoinMessage
+MakeMessage (enum Messages type)
+{
+  bitcoinMessage msg;
+  msg.type = type;
+  msg.hop = 0;
+  msg.mode = 0;
+  msg.setSize = 0;
+  msg.filterBegin = 0;
+  msg.filterEnd = 0;
+  msg.block = 0;
+  return msg;
+}
+
+/**
+ * The node learns a transaction from one peer and queues its INV to the other, which then sends
+ * a block holding the transaction before the INV leaves. The peer which sent the block must not
+ * get the INV.
+ */
+class BitcoinBlockSenderTestCase : public TestCase
+{
+public:
+  BitcoinBlockSenderTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+BitcoinBlockSenderTestCase::BitcoinBlockSenderTestCase ()
+  : TestCase ("no INV of a block transaction goes back to the peer which sent the block")
+{
+}
+
+void
+BitcoinBlockSenderTestCase::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (3);
+  uint32_t node = nodes.Get (0)->GetId ();
+  uint32_t miner = nodes.Get (1)->GetId ();
+  uint32_t origin = nodes.Get (2)->GetId ();
+
+  Ipv4Address nodeToMiner ("10.0.0.1"), minerToNode ("10.0.0.2");
+  Ipv4Address nodeToOrigin ("10.0.1.1"), originToNode ("10.0.1.2");
+  Ptr<BitcoinChannel> channel = CreateObject<BitcoinChannel> ();
+  channel->AddLink (node, nodeToMiner, miner, minerToNode, 0, MilliSeconds (1));
+  channel->AddLink (node, nodeToOrigin, origin, originToNode, 0, MilliSeconds (1));
+
+  std::vector<Ipv4Address> peers;
+  peers.push_back (minerToNode);
+  peers.push_back (originToNode);
+  std::map<Ipv4Address, double> peersSpeeds;
+  nodeInternetSpeeds internetSpeeds = {100, 100};
+  nodeStatistics stats = nodeStatistics ();
+
+  ProtocolSettings protocolSettings = ProtocolSettings ();
+  protocolSettings.protocol = STANDARD_PROTOCOL;
+  protocolSettings.invIntervalSeconds = 2;
+  protocolSettings.reconciliationMode = RECON_OFF;
+  protocolSettings.reconciliationIntervalSeconds = 5;
+  protocolSettings.wireFormat = BINARY_WIRE;
+
+  BitcoinNodeHelper helper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), 8333),
+                            peers, peersSpeeds, peersSpeeds, internetSpeeds, &stats, protocolSettings);
+  helper.SetChannel (channel);
+  helper.SetProperties (60, REGULAR, 0, peers);
+  ApplicationContainer apps = helper.Install (nodes.Get (0));
+  apps.Start (Seconds (0));
+  apps.Stop (Seconds (50));
+
+  // The INV of the origin arrives at 1.001 s, and the node announces the transaction to the miner
+  // 0.1 s later at the earliest, after the block arrived at 1.011 s
+  int tx = 5;
+  bitcoinMessage inv = MakeMessage (INV);
+  inv.txs.push_back (tx);
+  Simulator::Schedule (Seconds (1), &BitcoinChannel::Send, channel, origin, nodeToOrigin, inv, 0);
+
+  // The block also holds a transaction the node misses, so it waits for a BLOCK_TXN which never comes
+  bitcoinMessage block = MakeMessage (CMPCT_BLOCK);
+  block.txs.push_back (tx);
+  block.txs.push_back (tx + 1);
+  Simulator::Schedule (Seconds (1.01), &BitcoinChannel::Send, channel, miner, nodeToMiner, block, 0);
+
+  Simulator::Stop (Seconds (30));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (stats.txReceived, 1, "The node did not learn the transaction");
+  NS_TEST_ASSERT_MSG_EQ (stats.txPackets[GET_BLOCK_TXN], 1, "The node did not request the missing transaction");
+  NS_TEST_ASSERT_MSG_EQ (stats.invEventsCancelled, 1, "The INV to the miner was not cancelled");
+  NS_TEST_ASSERT_MSG_EQ (stats.txPackets[INV], 0, "The node announced a block transaction to the peer which sent the block");
+}
+
+
+class BitcoinBlockRelayTestSuite : public TestSuite
+{
+public:
+  BitcoinBlockRelayTestSuite ();
+};
+
+BitcoinBlockRelayTestSuite::BitcoinBlockRelayTestSuite ()
+  : TestSuite ("bitcoin-block-relay", UNIT)
+{
+  AddTestCase (new BitcoinBlockSenderTestCase, TestCase::QUICK);
+}
+
+static BitcoinBlockRelayTestSuite g_bitcoinBlockRelayTestSuite;
@@ -0,0 +1,390 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Tests of BitcoinCodec: the JSON frames against the documents the nodes built before the codec,
+ * and the round trip of every message type through each wire format, including the virtual payloads
+ * of BitcoinHeader.
+ *
+ * ./test.py -s bitcoin-message
+ */
+
+#include <string>
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "ns3/bitcoin-message.h"
+
+using namespace ns3;
+
+static bitcoinMessage
+MakeMessage (enum Messages type)
+{
+  bitcoinMessage msg;
+  msg.type = type;
+  msg.hop = 0;
+  msg.mode = 0;
+  msg.setSize = 0;
+  msg.filterBegin = 0;
+  msg.filterEnd = 0;
+  msg.block = 0;
+  return msg;
+}
+
+static uint32_t
+ReadU32 (const std::string &data, size_t pos)
+{
+  const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data.data() + pos);
+  return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+}
+
+/**
+ * A message of every type the nodes send, with the JSON document it is encoded to
+ */
+typedef struct {
+  bitcoinMessage message;
+  std::string    document;
+} messageSample;
+
+static std::vector<messageSample>
+MessageSamples (void)
+{
+  std::vector<messageSample> samples;
+  bitcoinMessage msg;
+
+  /**
+   * The documents of INV, MODE, RECONCILE_TX_REQUEST and RECONCILE_TX_RESPONSE are the ones
+   * SendInvToNode, AnnounceMode, ReconcileWithPeer and RespondToReconciliationRequest wrote
+   * with rapidjson before BitcoinCodec, in front of their '#' delimiter.
+   */
+  msg = MakeMessage (INV);
+  msg.txs.push_back (3000017);
+  msg.hop = 4;
+  samples.push_back ({msg, "{\"message\":0,\"inv\":[3000017],\"hop\":4}"});
+
+  msg = MakeMessage (MODE);
+  msg.mode = 3;
+  samples.push_back ({msg, "{\"message\":4,\"mode\":3}"});
+
+  msg = MakeMessage (RECONCILE_TX_REQUEST);
+  msg.setSize = 27;
+  samples.push_back ({msg, "{\"message\":7,\"setSize\":27}"});
+
+  msg = MakeMessage (RECONCILE_TX_RESPONSE);
+  msg.txs = {12, -5, 2147483647};
+  samples.push_back ({msg, "{\"message\":8,\"transactions\":[12,-5,2147483647]}"});
+
+  msg = MakeMessage (RECONCILE_TX_RESPONSE);
+  samples.push_back ({msg, "{\"message\":8,\"transactions\":[]}"});
+
+  /**
+   * The later message types follow the same conventions
+   */
+  msg = MakeMessage (FILTER_REQUEST);
+  msg.filterBegin = 100;
+  msg.filterEnd = 350;
+  samples.push_back ({msg, "{\"message\":3,\"filterBegin\":100,\"filterEnd\":350}"});
+
+  msg = MakeMessage (UPDATE_FILTER_BEGIN);
+  msg.filterBegin = 75;
+  samples.push_back ({msg, "{\"message\":5,\"filterBegin\":75}"});
+
+  msg = MakeMessage (UPDATE_FILTER_END);
+  msg.filterEnd = 900;
+  samples.push_back ({msg, "{\"message\":6,\"filterEnd\":900}"});
+
+  msg = MakeMessage (RECONCILE_SKETCH);
+  msg.sketch = {1, 4000000000u};
+  msg.setSize = 8;
+  samples.push_back ({msg, "{\"message\":9,\"sketch\":[1,4000000000],\"setSize\":8}"});
+
+  msg = MakeMessage (RECONCILE_BISECTION_REQUEST);
+  samples.push_back ({msg, "{\"message\":10}"});
+
+  msg = MakeMessage (RECONCILE_BISECTION_SKETCH);
+  msg.sketch = {7};
+  msg.setSize = 2;
+  samples.push_back ({msg, "{\"message\":11,\"sketch\":[7],\"setSize\":2}"});
+
+  msg = MakeMessage (RECONCILE_FALLBACK_REQUEST);
+  samples.push_back ({msg, "{\"message\":12}"});
+
+  msg = MakeMessage (RECONCILE_DIFF);
+  msg.txs = {5, 6};
+  msg.setSize = 40;
+  samples.push_back ({msg, "{\"message\":13,\"transactions\":[5,6],\"setSize\":40}"});
+
+  msg = MakeMessage (DANDELION_TX);
+  msg.txs.push_back (42);
+  msg.hop = 1;
+  samples.push_back ({msg, "{\"message\":14,\"inv\":[42],\"hop\":1}"});
+
+  msg = MakeMessage (CMPCT_BLOCK);
+  msg.txs = {1, 2, 3};
+  msg.block = 9;
+  samples.push_back ({msg, "{\"message\":15,\"transactions\":[1,2,3],\"block\":9}"});
+
+  msg = MakeMessage (GET_BLOCK_TXN);
+  msg.txs.push_back (2);
+  msg.block = 9;
+  samples.push_back ({msg, "{\"message\":16,\"transactions\":[2],\"block\":9}"});
+
+  msg = MakeMessage (BLOCK_TXN);
+  msg.txs.push_back (2);
+  msg.block = 9;
+  samples.push_back ({msg, "{\"message\":17,\"transactions\":[2],\"block\":9}"});
+
+  return samples;
+}
+
+static bool
+SameMessage (const bitcoinMessage &a, const bitcoinMessage &b)
+{
+  return a.type == b.type && a.hop == b.hop && a.mode == b.mode && a.setSize == b.setSize
+         && a.filterBegin == b.filterBegin && a.filterEnd == b.filterEnd && a.block == b.block
+         && a.txs == b.txs && a.sketch == b.sketch;
+}
+
+
+/**
+ * JSON_WIRE frames hold the documents of the original nodes, byte for byte
+ */
+class BitcoinJsonWireTestCase : public TestCase
+{
+public:
+  BitcoinJsonWireTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+BitcoinJsonWireTestCase::BitcoinJsonWireTestCase ()
+  : TestCase ("JSON frames carry the documents of the original nodes")
+{
+}
+
+void
+BitcoinJsonWireTestCase::DoRun (void)
+{
+  for (const messageSample &sample: MessageSamples ())
+  {
+    std::string frame;
+    BitcoinCodec::Encode (sample.message, JSON_WIRE, frame);
+
+    NS_TEST_ASSERT_MSG_EQ (frame.size (), JSON_PREFIX_SIZE + sample.document.size () + 1, "Wrong frame size for " << sample.document);
+    NS_TEST_ASSERT_MSG_EQ (ReadU32 (frame, 0), sample.document.size () + 1, "Wrong length prefix for " << sample.document);
+    NS_TEST_ASSERT_MSG_EQ (frame.substr (JSON_PREFIX_SIZE, sample.document.size ()), sample.document, "The document differs");
+    NS_TEST_ASSERT_MSG_EQ (frame[frame.size () - 1], '\0', "Missing null terminator for " << sample.document);
+
+    size_t frameSize = 0;
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::NextFrame (frame.data (), frame.size () - 1, JSON_WIRE, frameSize), false, "Truncated frame accepted");
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::NextFrame (frame.data (), frame.size (), JSON_WIRE, frameSize), true, "Frame not found");
+    NS_TEST_ASSERT_MSG_EQ (frameSize, frame.size (), "Wrong frame size");
+
+    bitcoinMessage decoded = MakeMessage (INV);
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::Decode (frame.data (), frameSize, JSON_WIRE, decoded), true, "Decoding failed for " << sample.document);
+    NS_TEST_ASSERT_MSG_EQ (SameMessage (decoded, sample.message), true, "Round trip changed " << sample.document);
+  }
+}
+
+
+/**
+ * BINARY_WIRE frames follow the layout of bitcoin-message.h and decode to the encoded message
+ */
+class BitcoinBinaryWireTestCase : public TestCase
+{
+public:
+  BitcoinBinaryWireTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+BitcoinBinaryWireTestCase::BitcoinBinaryWireTestCase ()
+  : TestCase ("binary frames round trip")
+{
+}
+
+void
+BitcoinBinaryWireTestCase::DoRun (void)
+{
+  bitcoinMessage inv = MakeMessage (INV);
+  inv.txs = {1, 258};
+  inv.hop = 3;
+  const char invFrame[] = {0, 0, 3, 0, 12, 0, 0, 0,
+                           2, 0, 0, 0, 1, 0, 0, 0, 2, 1, 0, 0};
+  std::string frame;
+  BitcoinCodec::Encode (inv, BINARY_WIRE, frame);
+  NS_TEST_ASSERT_MSG_EQ (frame, std::string (invFrame, sizeof (invFrame)), "The INV frame does not follow the documented layout");
+
+  // Frames are self-delimiting, so they are decoded one after the other from a single stream
+  std::vector<messageSample> samples = MessageSamples ();
+  std::string stream;
+  for (const messageSample &sample: samples)
+    BitcoinCodec::Encode (sample.message, BINARY_WIRE, stream);
+
+  size_t pos = 0;
+  for (const messageSample &sample: samples)
+  {
+    size_t frameSize = 0;
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::NextFrame (stream.data () + pos, stream.size () - pos, BINARY_WIRE, frameSize), true, "Frame not found");
+
+    bitcoinMessage decoded = MakeMessage (INV);
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::Decode (stream.data () + pos, frameSize, BINARY_WIRE, decoded), true, "Decoding failed for " << sample.document);
+    NS_TEST_ASSERT_MSG_EQ (SameMessage (decoded, sample.message), true, "Round trip changed " << sample.document);
+    pos += frameSize;
+  }
+  NS_TEST_ASSERT_MSG_EQ (pos, stream.size (), "Bytes left after the last frame");
+
+  // A count which does not match the payload length is rejected
+  frame[8] = 3;
+  NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::Decode (frame.data (), frame.size (), BINARY_WIRE, inv), false, "Corrupted frame accepted");
+}
+
+
+/**
+ * VIRTUAL_WIRE frames are a fixed-size BitcoinHeader in front of the padding, and hand over the
+ * message through the store
+ */
+class BitcoinVirtualWireTestCase : public TestCase
+{
+public:
+  BitcoinVirtualWireTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+BitcoinVirtualWireTestCase::BitcoinVirtualWireTestCase ()
+  : TestCase ("virtual payloads round trip")
+{
+}
+
+void
+BitcoinVirtualWireTestCase::DoRun (void)
+{
+  BitcoinMessageStore &store = BitcoinMessageStore::Get ();
+  size_t stored = store.Size ();
+  uint32_t padding = 100;
+
+  for (const messageSample &sample: MessageSamples ())
+  {
+    const bitcoinMessage &msg = sample.message;
+    Ptr<Packet> packet = Create<Packet> (padding);
+    packet->AddHeader (BitcoinHeader (msg.type, msg.hop, store.Put (msg), padding));
+    NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), VIRTUAL_FRAME_SIZE + padding, "The header size depends on the message");
+
+    std::string stream (packet->GetSize (), '\0');
+    packet->CopyData (reinterpret_cast<uint8_t*> (&stream[0]), stream.size ());
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::BytesMissing (stream.data (), BINARY_HEADER_SIZE - 3), 3u, "Wrong count up to the frame length");
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::BytesMissing (stream.data (), BINARY_HEADER_SIZE), 8u, "Wrong count up to the frame end");
+
+    size_t frameSize = 0;
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::NextFrame (stream.data (), stream.size (), VIRTUAL_WIRE, frameSize), true, "Frame not found");
+    NS_TEST_ASSERT_MSG_EQ (frameSize, VIRTUAL_FRAME_SIZE, "Wrong frame size");
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::PaddingSize (stream.data (), frameSize), padding, "Wrong padding");
+
+    bitcoinMessage decoded = MakeMessage (INV);
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::Decode (stream.data (), frameSize, VIRTUAL_WIRE, decoded), true, "Decoding failed for " << sample.document);
+    NS_TEST_ASSERT_MSG_EQ (SameMessage (decoded, msg), true, "Round trip changed " << sample.document);
+
+    // A message is handed over once
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::Decode (stream.data (), frameSize, VIRTUAL_WIRE, decoded), false, "Message decoded twice");
+  }
+  NS_TEST_ASSERT_MSG_EQ (store.Size (), stored, "Messages left in the store");
+}
+
+
+/**
+ * A virtual packet takes the size of the real bitcoin message, without the TCP/IP headers the
+ * socket adds. Where the payload of the real message has the layout of the binary payload, the
+ * packet only differs from the binary frame by the size of the headers.
+ */
+class BitcoinVirtualSizeTestCase : public TestCase
+{
+public:
+  BitcoinVirtualSizeTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+BitcoinVirtualSizeTestCase::BitcoinVirtualSizeTestCase ()
+  : TestCase ("virtual packets have the size of the real messages")
+{
+}
+
+void
+BitcoinVirtualSizeTestCase::DoRun (void)
+{
+  BitcoinMessageStore &store = BitcoinMessageStore::Get ();
+  size_t stored = store.Size ();
+
+  std::vector<bitcoinMessage> messages;
+  messages.push_back (MakeMessage (MODE));
+  messages.push_back (MakeMessage (RECONCILE_TX_REQUEST));
+  bitcoinMessage sketch = MakeMessage (RECONCILE_SKETCH);
+  sketch.sketch = {7, 8, 9};
+  messages.push_back (sketch);
+  bitcoinMessage diff = MakeMessage (RECONCILE_DIFF);
+  diff.txs = {1, 2, 3, 4, 5};
+  messages.push_back (diff);
+
+  for (const bitcoinMessage &msg: messages)
+  {
+    std::string binary;
+    BitcoinCodec::Encode (msg, BINARY_WIRE, binary);
+    uint32_t payloadSize = binary.size () - BINARY_HEADER_SIZE;
+
+    Ptr<Packet> packet = BitcoinCodec::EncodeVirtual (msg, payloadSize);
+    NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), BITCOIN_HEADER_SIZE + payloadSize, "Wrong size of message " << msg.type);
+    NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), binary.size () + BITCOIN_HEADER_SIZE - BINARY_HEADER_SIZE, "Virtual and binary sizes differ for message " << msg.type);
+
+    std::string frame (VIRTUAL_FRAME_SIZE, '\0');
+    packet->CopyData (reinterpret_cast<uint8_t*> (&frame[0]), frame.size ());
+    bitcoinMessage decoded = MakeMessage (INV);
+    NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::Decode (frame.data (), frame.size (), VIRTUAL_WIRE, decoded), true, "Decoding failed");
+  }
+
+  // An INV of n transactions takes 36 Byte inventories instead of the 4 Byte ids of the binary frame
+  bitcoinMessage inv = MakeMessage (INV);
+  inv.txs = {1, 2, 3};
+  std::string binary, json;
+  BitcoinCodec::Encode (inv, BINARY_WIRE, binary);
+  BitcoinCodec::Encode (inv, JSON_WIRE, json);
+  Ptr<Packet> packet = BitcoinCodec::EncodeVirtual (inv, 4 + 36 * inv.txs.size ());
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), binary.size () + BITCOIN_HEADER_SIZE - BINARY_HEADER_SIZE + 32 * inv.txs.size (), "Wrong size of an INV");
+  NS_TEST_ASSERT_MSG_GT (packet->GetSize (), json.size (), "The virtual INV is smaller than its JSON frame");
+  std::string frame (VIRTUAL_FRAME_SIZE, '\0');
+  packet->CopyData (reinterpret_cast<uint8_t*> (&frame[0]), frame.size ());
+  NS_TEST_ASSERT_MSG_EQ (BitcoinCodec::Decode (frame.data (), frame.size (), VIRTUAL_WIRE, inv), true, "Decoding failed");
+
+  NS_TEST_ASSERT_MSG_EQ (store.Size (), stored, "Messages left in the store");
+}
+
+
+class BitcoinMessageTestSuite : public TestSuite
+{
+public:
+  BitcoinMessageTestSuite ();
+};
+
+BitcoinMessageTestSuite::BitcoinMessageTestSuite ()
+  : TestSuite ("bitcoin-message", UNIT)
+{
+  AddTestCase (new BitcoinJsonWireTestCase, TestCase::QUICK);
+  AddTestCase (new BitcoinBinaryWireTestCase, TestCase::QUICK);
+  AddTestCase (new BitcoinVirtualWireTestCase, TestCase::QUICK);
+  AddTestCase (new BitcoinVirtualSizeTestCase, TestCase::QUICK);
+}
+
+static BitcoinMessageTestSuite bitcoinMessageTestSuite;